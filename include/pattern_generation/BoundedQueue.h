@@ -0,0 +1,103 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief      Fixed capacity FIFO shared by producer and consumer threads.
+ *
+ *             push() blocks while the queue is full, which throttles faster
+ *             stages to the pace of the slowest one and keeps the number of
+ *             in-flight items (and hence memory use) constant. Items live
+ *             in a ring of slots allocated up front, so pushing and popping
+ *             never allocate.
+ *
+ * @tparam     T     The item type
+ */
+template <typename T>
+class BoundedQueue
+{
+    private:
+        std::vector<T> slots;
+        std::size_t capacity;
+        std::size_t head;
+        std::size_t count;
+        bool closed;
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+
+    public:
+
+        /**
+         * @brief      Constructor
+         *
+         * @param      capacity  The maximum number of queued items
+         */
+        explicit BoundedQueue(std::size_t capacity) :
+            slots(capacity ? capacity : 1),
+            capacity(capacity ? capacity : 1),
+            head(0),
+            count(0),
+            closed(false) {}
+
+        /**
+         * @brief      Appends an item, waiting for a free slot if needed.
+         *
+         * @param      item  The item
+         *
+         * @return     False if the queue was closed and the item dropped.
+         */
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this]{ return closed || count < capacity; });
+            if (closed)
+                return false;
+            slots[(head + count) % capacity] = std::move(item);
+            ++count;
+            lock.unlock();
+            not_empty.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief      Removes the oldest item, waiting for one if needed.
+         *
+         * @param      item  The item
+         *
+         * @return     False once the queue is closed and drained.
+         */
+        bool pop(T & item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this]{ return closed || count > 0; });
+            if (count == 0)
+                return false;
+            item = std::move(slots[head]);
+            head = (head + 1) % capacity;
+            --count;
+            lock.unlock();
+            not_full.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief      Signals that no more items will be pushed. Consumers
+         *             still receive the items already queued.
+         */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            not_full.notify_all();
+            not_empty.notify_all();
+        }
+};
+
+#endif
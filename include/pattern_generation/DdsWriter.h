@@ -0,0 +1,33 @@
+#ifndef DDSWRITER_H
+#define DDSWRITER_H
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief      Encodes a mip chain as an uncompressed 24-bit RGB DDS file,
+ *             the container OGRE loads with its mipmaps, so that the levels
+ *             are not regenerated at load time. Pixels are taken in OpenCV
+ *             BGR order, which is the byte order of the DDS masks.
+ *
+ * @param      levels  The 8-bit, 3 channel levels, each half the size of the
+ *                     one above rounded down and at least 1, as drawn by
+ *                     ProceduralTexture::renderMipmaps()
+ * @param      buffer  The encoded file
+ *
+ * @return     False when the levels are not a mip chain.
+ */
+bool encodeDds(const std::vector<cv::Mat> & levels, std::vector<uchar> & buffer);
+
+/**
+ * @brief      Writes a mip chain to a DDS file.
+ *
+ * @param      path    The file path
+ * @param      levels  The levels, as for encodeDds()
+ *
+ * @return     False when the levels are not a mip chain or the write failed.
+ */
+bool writeDds(const std::string & path, const std::vector<cv::Mat> & levels);
+
+#endif
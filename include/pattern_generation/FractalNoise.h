@@ -0,0 +1,57 @@
+#include <cstddef>
+#include "pattern_generation/PerlinNoise.h"
+
+// Fractal sums of improved Perlin noise octaves: fractional Brownian motion,
+// turbulence and ridged multifractal (see F. K. Musgrave, "Procedural fractal
+// terrains", in Texturing and Modeling, 2003). Every octave reads the same
+// permutation vector, shifted so that the lattices of the octaves do not line up.
+
+#ifndef FRACTALNOISE_H
+#define FRACTALNOISE_H
+
+class FractalNoise {
+public:
+	// Ways of summing the octaves
+	enum Type { FBM, TURBULENCE, RIDGED };
+
+	// Sum octaves of the given noise, the permutation vector is copied
+	explicit FractalNoise(const PerlinNoise & noise, Type type = FBM, int octaves = 6,
+		float lacunarity = 2.0f, float gain = 0.5f);
+	// Sum octaves of noise with a permutation vector drawn from engine
+	explicit FractalNoise(RandomEngine & engine, Type type = FBM, int octaves = 6,
+		float lacunarity = 2.0f, float gain = 0.5f);
+
+	// Get a fractal noise value in [0, 1]
+	float noise(float x, float y, float z) const;
+	// Get the fractal noise values of n points (x[k], y, z) along a row. Each
+	// octave is evaluated over blocks of points at a time, along rows while
+	// its lattice cells are wide and with the vector batch once they shrink
+	void noiseRow(const float * x, float y, float z, float * out, size_t n) const;
+
+	// Leave out the octaves of higher frequency than the given one, in
+	// lattice cells per unit of x and y, each adding its mean value instead.
+	// Band limits the noise when it is sampled more coarsely, e.g. for the
+	// levels of a mip chain. Unlimited by default
+	void setMaxFrequency(float frequency);
+
+	Type getType() const { return type; }
+	int getOctaves() const { return octaves; }
+	float getLacunarity() const { return lacunarity; }
+	float getGain() const { return gain; }
+	float getMaxFrequency() const { return max_frequency; }
+private:
+	// The single permutation vector shared by all the octaves
+	PerlinNoise base;
+	Type type;
+	int octaves;
+	// Frequency multiplier between octaves
+	float lacunarity;
+	// Amplitude multiplier between octaves
+	float gain;
+	// Frequency above which octaves are left out
+	float max_frequency;
+
+	void noiseBlock(const float * x, float y, float z, float * out, size_t n) const;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief      Named stages timed per call, with a count, a total, a number of
+ *             items, e.g. pixels, and a histogram of the call latencies in
+ *             power of two buckets.
+ *
+ *             Stages are created on first use and live until the program
+ *             exits. Scoped timers only read the clock while instrumentation
+ *             is enabled, otherwise they cost one relaxed atomic load; with
+ *             PATTERN_GENERATION_NO_INSTRUMENTATION defined they compile to
+ *             nothing. All functions may be called from several threads.
+ */
+namespace Instrumentation
+{
+    /// Latency histogram buckets, bucket b counts calls under 2^b ns
+    const int BUCKETS = 40;
+
+    /**
+     * @brief      Call counters and latency histogram of one stage.
+     */
+    class Stage
+    {
+        private:
+            /// Stage name
+            std::string name;
+            /// Number of calls
+            std::atomic<uint64_t> calls;
+            /// Summed and longest duration, in nanoseconds
+            std::atomic<int64_t> total, longest;
+            /// Items processed
+            std::atomic<uint64_t> items;
+            /// Calls per latency bucket
+            std::atomic<uint64_t> histogram[BUCKETS];
+
+        public:
+            /**
+             * @brief      Creates an empty stage.
+             *
+             * @param      name  The name
+             */
+            explicit Stage(const std::string & name);
+
+            /**
+             * @brief      Records one call, whether instrumentation is
+             *             enabled or not.
+             *
+             * @param      nanoseconds  The call duration
+             * @param      count        The items processed
+             */
+            void add(int64_t nanoseconds, uint64_t count = 0);
+
+            /**
+             * @brief      Clears the counters.
+             */
+            void reset();
+
+            /**
+             * @brief      Gets the name.
+             */
+            const std::string & getName() const;
+
+            /**
+             * @brief      Gets the number of calls.
+             */
+            uint64_t getCalls() const;
+
+            /**
+             * @brief      Gets the summed duration of the calls, in seconds.
+             */
+            double getSeconds() const;
+
+            /**
+             * @brief      Gets the longest call, in seconds.
+             */
+            double getLongest() const;
+
+            /**
+             * @brief      Gets the number of items processed.
+             */
+            uint64_t getItems() const;
+
+            /**
+             * @brief      Gets the number of calls of a latency bucket.
+             *
+             * @param      bucket  The bucket, calls under 2^bucket ns
+             */
+            uint64_t getBucket(int bucket) const;
+
+            /**
+             * @brief      Gets a latency percentile, as the upper bound of
+             *             the bucket holding it.
+             *
+             * @param      fraction  The percentile, from 0 to 1
+             *
+             * @return     The latency in seconds, 0 without calls.
+             */
+            double getPercentile(double fraction) const;
+    };
+
+    /**
+     * @brief      Times the enclosing scope into a stage, when instrumentation
+     *             is enabled.
+     */
+    class ScopedTimer
+    {
+        private:
+            /// Stage timed, NULL when disabled
+            Stage * stage;
+            /// Items processed in the scope
+            uint64_t count;
+            /// Scope entry time
+            std::chrono::steady_clock::time_point begin;
+
+        public:
+            /**
+             * @brief      Starts timing.
+             *
+             * @param      stage  The stage
+             * @param      count  The items processed in the scope
+             */
+            ScopedTimer(Stage & stage, uint64_t count = 0);
+
+            /**
+             * @brief      Records the scope duration.
+             */
+            ~ScopedTimer();
+    };
+
+    /**
+     * @brief      Checks whether scoped timers record.
+     */
+    bool enabled();
+
+    /**
+     * @brief      Turns the scoped timers on or off. Off by default.
+     *
+     * @param      enable  Whether they record
+     */
+    void setEnabled(bool enable);
+
+    /**
+     * @brief      Gets a stage by name, creating it on first use.
+     *
+     * @param      name  The name
+     *
+     * @return     The stage, valid until the program exits.
+     */
+    Stage & stage(const std::string & name);
+
+    /**
+     * @brief      Gets every stage, in creation order.
+     */
+    std::vector<const Stage *> stages();
+
+    /**
+     * @brief      Clears the counters of every stage.
+     */
+    void reset();
+
+    /**
+     * @brief      Writes a table of the stages with calls.
+     *
+     * @param      os    The stream
+     */
+    void report(std::ostream & os);
+
+    /**
+     * @brief      Writes the stages with calls as a JSON object.
+     *
+     * @param      os    The stream
+     */
+    void reportJson(std::ostream & os);
+}
+
+inline Instrumentation::ScopedTimer::ScopedTimer(Stage & stage, uint64_t count) :
+    stage(enabled() ? &stage : NULL), count(count)
+{
+    if (this->stage)
+        begin = std::chrono::steady_clock::now();
+}
+
+inline Instrumentation::ScopedTimer::~ScopedTimer()
+{
+    if (stage)
+        stage->add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count(), count);
+}
+
+#define INSTRUMENTATION_CONCAT_(a, b) a##b
+#define INSTRUMENTATION_CONCAT(a, b) INSTRUMENTATION_CONCAT_(a, b)
+
+/// Times the enclosing scope into the stage of the given name, counting
+/// items processed. The stage is looked up once per call site
+#ifdef PATTERN_GENERATION_NO_INSTRUMENTATION
+#define INSTRUMENT_SCOPE(name, count)
+#else
+#define INSTRUMENT_SCOPE(name, count) \
+    static Instrumentation::Stage & INSTRUMENTATION_CONCAT(instrumented_stage_, __LINE__) = \
+        Instrumentation::stage(name); \
+    Instrumentation::ScopedTimer INSTRUMENTATION_CONCAT(instrumented_scope_, __LINE__)( \
+        INSTRUMENTATION_CONCAT(instrumented_stage_, __LINE__), count)
+#endif
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef PATTERNGENERATION_H
+#define PATTERNGENERATION_H
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -5,35 +8,258 @@
 #include <iostream>
 #include <random>
 #include "pattern_generation/PerlinNoise.h"
+#include "pattern_generation/FractalNoise.h"
+#include "pattern_generation/RandomEngine.h"
+#include "pattern_generation/TileRenderer.h"
 #include <memory>
+#include <mutex>
 #define RGB 0
 #define HSV 1
 #define HSL 2
 
+/**
+ * @brief      One texture: its pattern, size and parameters, drawn in a
+ *             batch or kept as a ProceduralTexture. Only the parameters of
+ *             the pattern are read, and they default to those of the single
+ *             texture generators.
+ */
+struct TextureSpec
+{
+    /// Patterns of the textures
+    enum Pattern { FLAT, CHESS, GRADIENT, PERLIN, FRACTAL };
+
+    /// Pattern
+    Pattern pattern;
+    /// Image size
+    cv::Size size;
+    /// Colors, the second one for chess and gradient textures
+    cv::Scalar color1, color2;
+    /// Chess square size
+    int block_size;
+    /// Gradient direction
+    bool vertical;
+    /// Random engine of the noise patterns, copied before use
+    RandomEngine rng;
+    /// Perlin noise color mode and channel planes
+    bool random_colors;
+    double z1, z2, z3;
+    /// Noise lattice cells across the image, 0 for the pattern default
+    double frequency;
+    /// Fractal noise parameters
+    FractalNoise::Type type;
+    int octaves;
+    double lacunarity, gain;
+
+    explicit TextureSpec(Pattern pattern = FLAT, const cv::Size & size = cv::Size()) :
+        pattern(pattern), size(size), block_size(75), vertical(true), random_colors(true),
+        z1(0.8), z2(0.8), z3(0.8), frequency(0), type(FractalNoise::FBM), octaves(6),
+        lacunarity(2.0), gain(0.5) {}
+};
+
+class ProceduralTexture;
+
 class PatternGeneration
 {
+	public:
+        /// Arithmetic used for the Perlin noise evaluation
+        enum Precision {
+            /// Scalar double precision, the reference
+            PRECISION_DOUBLE,
+            /// Single precision
+            PRECISION_FLOAT,
+            /// Scalar 16.16 fixed point
+            PRECISION_FIXED
+        };
+
+        /// Color space of the generated images, colors are always given in Lab
+        enum ColorSpace {
+            /// Converted to RGB, the default
+            COLOR_SPACE_RGB,
+            /// Kept in Lab, as generated
+            COLOR_SPACE_LAB
+        };
+
+        /// Default number of pre-shuffled Perlin permutation tables
+        static const int DEFAULT_PERLIN_TABLES = 256;
+
 	private:
-                std::shared_ptr<std::uniform_int_distribution<int> > dist;
+                /// Global seed all random streams are derived from
+                uint64_t seed;
+                /// Engine used by the overloads without an explicit engine
+                RandomEngine engine;
+                /// Perlin noise precision
+                Precision precision;
+                /// Output color space
+                ColorSpace color_space;
+                /// Splits the textures into tiles drawn in parallel
+                TileRenderer renderer;
+                /// Number of pre-shuffled Perlin permutation tables
+                int perlin_table_count;
+
+                /// Perlin permutation tables of one seed, each shuffled on
+                /// first use
+                struct PerlinTables
+                {
+                    /// The tables
+                    std::vector<PerlinNoise> tables;
+                    /// Set once the table of the same index is shuffled
+                    std::vector<std::once_flag> shuffled;
+                };
+                /// Tables of the current seed, NULL for none. Replaced when
+                /// the seed changes, textures keep the ones they picked from
+                std::shared_ptr<PerlinTables> perlin_tables;
+
+                /**
+                 * @brief      Replaces the Perlin permutation tables with
+                 *             ones of the current seed, not shuffled yet.
+                 */
+                void resetPerlinTables();
+
+                /**
+                 * @brief      Draws the random parameters of a texture,
+                 *             its permutation vector, pixel stream or noise
+                 *             planes, from rng.
+                 *
+                 * @param      spec  The texture, with its frequency set
+                 * @param      rng   The random engine, advanced
+                 *
+                 * @return     The texture.
+                 */
+                ProceduralTexture resolveTexture(
+                	const TextureSpec & spec,
+                	RandomEngine & rng) const;
 
 	public:
         
         /**
-         * @brief      Constructor
+         * @brief      Constructor, seeded from std::random_device
          */
 	    PatternGeneration();
 
+        /**
+         * @brief      Constructor
+         *
+         * @param      seed  The global seed
+         */
+	    explicit PatternGeneration(uint64_t seed);
+
 	    /**
 	     * @brief      Generates a seed for the rng
 	     */
 	    void seedRandom();
 
 	    /**
-	     * @brief      Gets the random color.
+	     * @brief      Sets the global seed.
+	     *
+	     * @param      seed  The seed
+	     */
+	    void setSeed(uint64_t seed);
+
+	    /**
+	     * @brief      Gets the global seed.
+	     *
+	     * @return     The seed.
+	     */
+	    uint64_t getSeed() const;
+
+	    /**
+	     * @brief      Sets the Perlin noise precision. Float is faster and
+	     *             may change a few pixels by an intensity level or two
+	     *             with respect to double. Fixed point uses integer
+	     *             arithmetic only, for targets without a fast floating
+	     *             point unit, and changes about a fifth of the pixels by
+	     *             up to two levels.
+	     *
+	     * @param      precision  The precision
+	     */
+	    void setPrecision(Precision precision);
+
+	    /**
+	     * @brief      Gets the Perlin noise precision.
+	     *
+	     * @return     The precision.
+	     */
+	    Precision getPrecision() const;
+
+	    /**
+	     * @brief      Sets the color space of the generated images. Only
+	     *             the distinct colors, or one row at a time, are
+	     *             converted from Lab, before filling the image.
+	     *
+	     * @param      color_space  The color space
+	     */
+	    void setColorSpace(ColorSpace color_space);
+
+	    /**
+	     * @brief      Gets the color space of the generated images.
+	     *
+	     * @return     The color space.
+	     */
+	    ColorSpace getColorSpace() const;
+
+	    /**
+	     * @brief      Sets the size of the tiles textures are drawn in, see
+	     *             TileRenderer.
+	     *
+	     * @param      tile_size  The tile size
+	     */
+	    void setTileSize(const cv::Size & tile_size);
+
+	    /**
+	     * @brief      Gets the size of the tiles textures are drawn in.
+	     *
+	     * @return     The tile size.
+	     */
+	    cv::Size getTileSize() const;
+
+	    /**
+	     * @brief      Sets the number of Perlin permutation tables drawn
+	     *             from the seed, each shuffled the first time it is
+	     *             picked. Perlin and fractal textures pick one with a
+	     *             single draw and share it instead of shuffling their
+	     *             own; 0 shuffles one per texture.
+	     *
+	     * @param      count  The number of tables
+	     */
+	    void setPerlinTableCount(int count);
+
+	    /**
+	     * @brief      Gets the number of Perlin permutation tables.
+	     *
+	     * @return     The number of tables.
+	     */
+	    int getPerlinTableCount() const;
+
+	    /**
+	     * @brief      Gets the engine of an independent random stream.
+	     *             The same (seed, index, stream) always yields the same
+	     *             sequence, so textures can be regenerated individually
+	     *             and in parallel.
+	     *
+	     * @param      index   The texture index
+	     * @param      stream  The stream id
+	     *
+	     * @return     The random engine.
+	     */
+	    RandomEngine getRandomEngine(uint64_t index, uint64_t stream) const;
+
+	    /**
+	     * @brief      Gets the random color, drawn from the internal engine.
+	     *             Not thread-safe, use the overload below from workers.
 	     *
 	     * @return     The random color.
 	     */
 	    cv::Scalar getRandomColor();
 
+	    /**
+	     * @brief      Gets the random color.
+	     *
+	     * @param      rng   The random engine
+	     *
+	     * @return     The random color.
+	     */
+	    cv::Scalar getRandomColor(RandomEngine & rng);
+
 	    /**
 	     * @brief      Gets a chess texture.
 	     *
@@ -49,6 +275,56 @@ class PatternGeneration
         	const cv::Scalar & color2,
         	int blockSize=75,
         	int squares=8);
+
+	    /**
+	     * @brief      Draws a chess texture into an allocated 8-bit, 3 channel
+	     *             image, squares are cut at the right and bottom edges.
+	     *
+	     * @param      color1     The color 1
+	     * @param      color2     The color 2
+	     * @param      blockSize  The block size
+	     * @param      texture    The image
+	     */
+        void getChessTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	int blockSize,
+        	cv::Mat & texture);
+
+	    /**
+	     * @brief      Draws a chess texture into a target, e.g. streamed in
+	     *             bands to a sink.
+	     *
+	     * @param      color1     The color 1
+	     * @param      color2     The color 2
+	     * @param      blockSize  The block size
+	     * @param      target     The target
+	     */
+        void getChessTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	int blockSize,
+        	const RenderTarget & target);
+
+	    /**
+	     * @brief      Draws a chess texture into a caller owned buffer.
+	     *
+	     * @param      color1     The color 1
+	     * @param      color2     The color 2
+	     * @param      blockSize  The block size
+	     * @param      data       The 8-bit, 3 channel pixels
+	     * @param      width      The width
+	     * @param      height     The height
+	     * @param      stride     The bytes between rows
+	     */
+        void getChessTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	int blockSize,
+        	uint8_t * data,
+        	int width,
+        	int height,
+        	size_t stride);
         
         /**
          * @brief      Gets a flat texture.
@@ -61,6 +337,43 @@ class PatternGeneration
         cv::Mat getFlatTexture(
         	const cv::Scalar & color,
         	const int & imageSize);
+
+        /**
+         * @brief      Draws a flat texture into an allocated 8-bit, 3 channel
+         *             image.
+         *
+         * @param      color    The color
+         * @param      texture  The image
+         */
+        void getFlatTexture(
+        	const cv::Scalar & color,
+        	cv::Mat & texture);
+
+        /**
+         * @brief      Draws a flat texture into a target.
+         *
+         * @param      color   The color
+         * @param      target  The target
+         */
+        void getFlatTexture(
+        	const cv::Scalar & color,
+        	const RenderTarget & target);
+
+        /**
+         * @brief      Draws a flat texture into a caller owned buffer.
+         *
+         * @param      color   The color
+         * @param      data    The 8-bit, 3 channel pixels
+         * @param      width   The width
+         * @param      height  The height
+         * @param      stride  The bytes between rows
+         */
+        void getFlatTexture(
+        	const cv::Scalar & color,
+        	uint8_t * data,
+        	int width,
+        	int height,
+        	size_t stride);
         
         /**
          * @brief      Gets a gradient texture.
@@ -77,6 +390,55 @@ class PatternGeneration
         	const cv::Scalar & color2,
         	const int & imageSize,
         	bool vertical=true);
+
+        /**
+         * @brief      Draws a gradient texture into an allocated 8-bit, 3
+         *             channel image.
+         *
+         * @param      color1    The color 1
+         * @param      color2    The color 2
+         * @param      texture   The image
+         * @param      vertical  The vertical
+         */
+        void getGradientTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	cv::Mat & texture,
+        	bool vertical=true);
+
+        /**
+         * @brief      Draws a gradient texture into a target.
+         *
+         * @param      color1    The color 1
+         * @param      color2    The color 2
+         * @param      target    The target
+         * @param      vertical  The vertical
+         */
+        void getGradientTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	const RenderTarget & target,
+        	bool vertical=true);
+
+        /**
+         * @brief      Draws a gradient texture into a caller owned buffer.
+         *
+         * @param      color1    The color 1
+         * @param      color2    The color 2
+         * @param      data      The 8-bit, 3 channel pixels
+         * @param      width     The width
+         * @param      height    The height
+         * @param      stride    The bytes between rows
+         * @param      vertical  The vertical
+         */
+        void getGradientTexture(
+        	const cv::Scalar & color1,
+        	const cv::Scalar & color2,
+        	uint8_t * data,
+        	int width,
+        	int height,
+        	size_t stride,
+        	bool vertical=true);
         
         /**
          * @brief      Gets the perlin noise texture.
@@ -95,4 +457,384 @@ class PatternGeneration
         	const double & z1=0.8,
         	const double & z2=0.8,
         	const double & z3=0.8);
+
+        /**
+         * @brief      Gets the perlin noise texture.
+         *
+         * @param      imageSize      The image size
+         * @param      rng            The random engine for the permutation
+         *                            vector and the random colors
+         * @param      random_colors  The random colors
+         * @param      z1             The z 1
+         * @param      z2             The z 2
+         * @param      z3             The z 3
+         * @param      frequency      The number of noise lattice cells
+         *                            across the image
+         *
+         * @return     The perlin noise texture.
+         */
+        cv::Mat getPerlinNoiseTexture(
+        	const int & imageSize,
+        	RandomEngine & rng,
+        	const bool & random_colors=true,
+        	const double & z1=0.8,
+        	const double & z2=0.8,
+        	const double & z3=0.8,
+        	const double & frequency=1.0);
+
+        /**
+         * @brief      Draws a perlin noise texture into an allocated 8-bit, 3
+         *             channel image. Lattice cells are square, with frequency
+         *             of them across the width.
+         *
+         * @param      rng            The random engine for the permutation
+         *                            vector and the random colors
+         * @param      texture        The image
+         * @param      random_colors  The random colors
+         * @param      z1             The z 1
+         * @param      z2             The z 2
+         * @param      z3             The z 3
+         * @param      frequency      The number of noise lattice cells
+         *                            across the image
+         */
+        void getPerlinNoiseTexture(
+        	RandomEngine & rng,
+        	cv::Mat & texture,
+        	const bool & random_colors=true,
+        	const double & z1=0.8,
+        	const double & z2=0.8,
+        	const double & z3=0.8,
+        	const double & frequency=1.0);
+
+        /**
+         * @brief      Draws a perlin noise texture into a target. Streamed
+         *             textures are identical to the ones drawn in place.
+         *
+         * @param      rng            The random engine picking the
+         *                            permutation vector and drawing the
+         *                            random colors
+         * @param      target         The target
+         * @param      random_colors  The random colors
+         * @param      z1             The z 1
+         * @param      z2             The z 2
+         * @param      z3             The z 3
+         * @param      frequency      The number of noise lattice cells
+         *                            across the image
+         */
+        void getPerlinNoiseTexture(
+        	RandomEngine & rng,
+        	const RenderTarget & target,
+        	const bool & random_colors=true,
+        	const double & z1=0.8,
+        	const double & z2=0.8,
+        	const double & z3=0.8,
+        	const double & frequency=1.0);
+
+        /**
+         * @brief      Draws a perlin noise texture into a caller owned buffer.
+         *
+         * @param      rng            The random engine for the permutation
+         *                            vector and the random colors
+         * @param      data           The 8-bit, 3 channel pixels
+         * @param      width          The width
+         * @param      height         The height
+         * @param      stride         The bytes between rows
+         * @param      random_colors  The random colors
+         * @param      z1             The z 1
+         * @param      z2             The z 2
+         * @param      z3             The z 3
+         * @param      frequency      The number of noise lattice cells
+         *                            across the image
+         */
+        void getPerlinNoiseTexture(
+        	RandomEngine & rng,
+        	uint8_t * data,
+        	int width,
+        	int height,
+        	size_t stride,
+        	const bool & random_colors=true,
+        	const double & z1=0.8,
+        	const double & z2=0.8,
+        	const double & z3=0.8,
+        	const double & frequency=1.0);
+
+        /**
+         * @brief      Gets a fractal noise texture, the three Lab channels are
+         *             fractal sums of Perlin noise octaves on planes drawn
+         *             from rng. Always evaluated in single precision.
+         *
+         * @param      imageSize   The image size
+         * @param      rng         The random engine for the permutation
+         *                         vector and the channel planes
+         * @param      type        The way octaves are summed
+         * @param      octaves     The number of octaves
+         * @param      lacunarity  The frequency multiplier between octaves
+         * @param      gain        The amplitude multiplier between octaves
+         * @param      frequency   The number of lattice cells across the
+         *                         image for the first octave
+         *
+         * @return     The fractal noise texture.
+         */
+        cv::Mat getFractalNoiseTexture(
+        	const int & imageSize,
+        	RandomEngine & rng,
+        	const FractalNoise::Type & type=FractalNoise::FBM,
+        	const int & octaves=6,
+        	const double & lacunarity=2.0,
+        	const double & gain=0.5,
+        	const double & frequency=4.0);
+
+        /**
+         * @brief      Draws a fractal noise texture into an allocated 8-bit, 3
+         *             channel image. Lattice cells are square, with frequency
+         *             of them across the width.
+         *
+         * @param      rng         The random engine for the permutation
+         *                         vector and the channel planes
+         * @param      texture     The image
+         * @param      type        The way octaves are summed
+         * @param      octaves     The number of octaves
+         * @param      lacunarity  The frequency multiplier between octaves
+         * @param      gain        The amplitude multiplier between octaves
+         * @param      frequency   The number of lattice cells across the
+         *                         image for the first octave
+         */
+        void getFractalNoiseTexture(
+        	RandomEngine & rng,
+        	cv::Mat & texture,
+        	const FractalNoise::Type & type=FractalNoise::FBM,
+        	const int & octaves=6,
+        	const double & lacunarity=2.0,
+        	const double & gain=0.5,
+        	const double & frequency=4.0);
+
+        /**
+         * @brief      Draws a fractal noise texture into a target.
+         *
+         * @param      rng         The random engine picking the permutation
+         *                         vector and drawing the channel planes
+         * @param      target      The target
+         * @param      type        The way octaves are summed
+         * @param      octaves     The number of octaves
+         * @param      lacunarity  The frequency multiplier between octaves
+         * @param      gain        The amplitude multiplier between octaves
+         * @param      frequency   The number of lattice cells across the
+         *                         image for the first octave
+         */
+        void getFractalNoiseTexture(
+        	RandomEngine & rng,
+        	const RenderTarget & target,
+        	const FractalNoise::Type & type=FractalNoise::FBM,
+        	const int & octaves=6,
+        	const double & lacunarity=2.0,
+        	const double & gain=0.5,
+        	const double & frequency=4.0);
+
+        /**
+         * @brief      Draws a fractal noise texture into a caller owned buffer.
+         *
+         * @param      rng         The random engine for the permutation
+         *                         vector and the channel planes
+         * @param      data        The 8-bit, 3 channel pixels
+         * @param      width       The width
+         * @param      height      The height
+         * @param      stride      The bytes between rows
+         * @param      type        The way octaves are summed
+         * @param      octaves     The number of octaves
+         * @param      lacunarity  The frequency multiplier between octaves
+         * @param      gain        The amplitude multiplier between octaves
+         * @param      frequency   The number of lattice cells across the
+         *                         image for the first octave
+         */
+        void getFractalNoiseTexture(
+        	RandomEngine & rng,
+        	uint8_t * data,
+        	int width,
+        	int height,
+        	size_t stride,
+        	const FractalNoise::Type & type=FractalNoise::FBM,
+        	const int & octaves=6,
+        	const double & lacunarity=2.0,
+        	const double & gain=0.5,
+        	const double & frequency=4.0);
+
+        /**
+         * @brief      Gets a texture that is only drawn on demand. Its random
+         *             parameters are drawn from a copy of spec.rng, and the
+         *             precision, color space and tile size are the current
+         *             ones, so it is the texture generateBatch would draw.
+         *
+         * @param      spec  The texture
+         *
+         * @return     The texture, independent of this generator.
+         */
+        ProceduralTexture getProceduralTexture(const TextureSpec & spec) const;
+
+        /**
+         * @brief      Draws many textures in a single parallel region.
+         *             Textures with fewer tiles than there are threads are
+         *             drawn whole, one per thread, and the others tile by
+         *             tile, so that batches of small textures keep every
+         *             core busy. Each texture is the same as drawn alone.
+         *
+         * @param      specs     The textures
+         * @param      textures  The images, reallocated only when their
+         *                       size changes
+         */
+        void generateBatch(
+        	const std::vector<TextureSpec> & specs,
+        	std::vector<cv::Mat> & textures);
 };
+
+/**
+ * @brief      A texture kept as its parameters: pattern, colors, permutation
+ *             vector and pixel stream. Nothing is drawn until a region is
+ *             requested, and then only its pixels are evaluated, so readers
+ *             of a sub-region or a lower resolution only pay for the pixels
+ *             they read. Every region is identical to the same rectangle of
+ *             the whole texture.
+ *
+ *             A texture can also be drawn at another size than its own: noise
+ *             and gradients are evaluated as if generated at that size, with
+ *             the same lattice cells and colors across the image, and chess
+ *             squares are scaled with the image. Rendering is const and may
+ *             run on several threads at once.
+ */
+class ProceduralTexture
+{
+    friend class PatternGeneration;
+
+    private:
+        /// Pattern, size and parameters, colors in Lab
+        TextureSpec spec;
+        /// Perlin noise precision
+        PatternGeneration::Precision precision;
+        /// Output color space
+        PatternGeneration::ColorSpace color_space;
+        /// Splits the regions into tiles drawn in parallel
+        TileRenderer renderer;
+        /// Permutation vector of the noise patterns, shared with the table
+        /// pool it was picked from. NULL for the other patterns
+        std::shared_ptr<const PerlinNoise> noise;
+        /// Stream of the Perlin random colors
+        RandomEngine pixel_rng;
+        /// Fractal noise channel planes
+        float fractal_z[3];
+
+        /**
+         * @brief      Constructor, the random parameters are drawn by
+         *             PatternGeneration.
+         *
+         * @param      spec         The texture
+         * @param      precision    The Perlin noise precision
+         * @param      color_space  The output color space
+         * @param      renderer     The tile renderer
+         */
+        ProceduralTexture(
+        	const TextureSpec & spec,
+        	PatternGeneration::Precision precision,
+        	PatternGeneration::ColorSpace color_space,
+        	const TileRenderer & renderer);
+
+        /**
+         * @brief      Draws the texture at the target size, either evaluated
+         *             at that size or, filtered, band limited to it as a
+         *             level of its mip chain: flat, gradient and chess pixels
+         *             are the exact average of the texture pixels they cover,
+         *             fractal noise leaves out the octaves finer than two
+         *             pixels and Perlin wood rings are averaged over the
+         *             noise range of every pixel. Perlin textures with random
+         *             colors are never filtered.
+         *
+         * @param      target    The target
+         * @param      filtered  Whether to band limit to the target size
+         */
+        void render(const RenderTarget & target, bool filtered) const;
+
+    public:
+
+        /**
+         * @brief      Gets the pattern, size and parameters.
+         *
+         * @return     The texture spec.
+         */
+        const TextureSpec & getSpec() const;
+
+        /**
+         * @brief      Gets the size of the whole texture.
+         *
+         * @return     The size.
+         */
+        cv::Size getSize() const;
+
+        /**
+         * @brief      Draws the texture at the target size: the whole image,
+         *             streamed or in place, or the rectangle of a region
+         *             target.
+         *
+         * @param      target  The target
+         */
+        void render(const RenderTarget & target) const;
+
+        /**
+         * @brief      Draws one rectangle of the texture.
+         *
+         * @param      region  The rectangle, within the size drawn at
+         * @param      pixels  The 8-bit, 3 channel pixels, reallocated only
+         *                     when they do not have the rectangle size
+         * @param      size    The size of the whole texture drawn at, empty
+         *                     for the texture size
+         */
+        void render(
+        	const cv::Rect & region,
+        	cv::Mat & pixels,
+        	const cv::Size & size = cv::Size()) const;
+
+        /**
+         * @brief      Gets one rectangle of the texture.
+         *
+         * @param      region  The rectangle, within the size drawn at
+         * @param      size    The size of the whole texture drawn at, empty
+         *                     for the texture size
+         *
+         * @return     The 8-bit, 3 channel pixels of the rectangle.
+         */
+        cv::Mat getRegion(const cv::Rect & region, const cv::Size & size = cv::Size()) const;
+
+        /**
+         * @brief      Gets the number of levels of the full mip chain, from
+         *             the texture down to 1x1 pixels.
+         *
+         * @return     The number of levels.
+         */
+        int getMipLevels() const;
+
+        /**
+         * @brief      Gets the size of a mip level, half the one above
+         *             rounded down, and at least 1.
+         *
+         * @param      level  The level, 0 for the texture
+         *
+         * @return     The size.
+         */
+        cv::Size getMipSize(int level) const;
+
+        /**
+         * @brief      Draws the mip chain straight from the texture
+         *             definition rather than by downsampling the texture.
+         *             Flat, gradient and chess levels are exact, fractal
+         *             noise levels are band limited and Perlin levels with
+         *             fixed colors box filter the wood rings. Random colors
+         *             have no band limited form, so their levels are area
+         *             averages of the level above.
+         *
+         * @param      levels  The 8-bit, 3 channel levels, resized to the
+         *                     number of levels and reallocated only when
+         *                     their size changes
+         * @param      first   The first level drawn, the ones above it are
+         *                     taken as already drawn
+         */
+        void renderMipmaps(std::vector<cv::Mat> & levels, int first = 0) const;
+};
+
+#endif
@@ -1,4 +1,7 @@
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "pattern_generation/RandomEngine.h"
 
 // THIS CLASS IS A TRANSLATION TO C++11 FROM THE REFERENCE
 // JAVA IMPLEMENTATION OF THE IMPROVED PERLIN FUNCTION (see http://mrl.nyu.edu/~perlin/noise/)
@@ -10,17 +13,68 @@
 #define PERLINNOISE_H
 
 class PerlinNoise {
-	// The permutation vector
-	std::vector<int> p;
+	// The permutation vector, 256 bytes stored twice. Inline, so that
+	// creating a PerlinNoise does not allocate. Not over-aligned, as C++11
+	// operator new would not honour it for the pooled tables. The vector
+	// gathers load 4 bytes per entry, the padding keeps those of the last
+	// entries in bounds
+	std::array<uint8_t, 512 + 4> p;
 public:
-	// Initialize with the reference values for the permutation vector
-	PerlinNoise();
+	// Initialize with a permutation vector shuffled by an engine seeded with seed
+	explicit PerlinNoise(uint64_t seed = 0);
+	// Initialize with a permutation vector shuffled by the given engine
+	explicit PerlinNoise(RandomEngine & engine);
+	// Reshuffle the permutation vector with the given engine
+	void shuffle(RandomEngine & engine);
 	// Get a noise value, for 2D images z can have any value
-	double noise(double x, double y, double z);
+	double noise(double x, double y, double z) const;
+	// Same in single precision
+	float noisef(float x, float y, float z) const;
+	// Same in 16.16 fixed point, the result is in [0, 65536]
+	int32_t noiseFixed(int32_t x, int32_t y, int32_t z) const;
+	// Get the noise values at (x, y, z[c]) for a number of planes in a single
+	// pass, the x and y lattice work is done only once
+	void noise(double x, double y, const double * z, double * out, int planes) const;
+	// Same in single precision
+	void noisef(float x, float y, const float * z, float * out, int planes) const;
+	// Same in 16.16 fixed point
+	void noiseFixed(int32_t x, int32_t y, const int32_t * z, int32_t * out, int planes) const;
+	// Get the noise values of n points (x[k], y, z) along a row. The corner
+	// gradients are computed once per lattice cell crossed, after which each
+	// point costs a few multiply-adds. Scaling x and y sets the frequency
+	void noiseRow(const double * x, double y, double z, double * out, size_t n) const;
+	// Same for n points (x[k], y, z[k])
+	void noiseRow(const double * x, double y, const double * z, double * out, size_t n) const;
+	// Same in single precision
+	void noiseRow(const float * x, float y, float z, float * out, size_t n) const;
+	void noiseRow(const float * x, float y, const float * z, float * out, size_t n) const;
+
+	// Instruction sets for the batch evaluation, in increasing order
+	enum SimdLevel { SIMD_SCALAR, SIMD_SSE4, SIMD_AVX2, SIMD_AVX512 };
+	// Best instruction set supported by the running CPU
+	static SimdLevel simdLevel();
+	// Get the noise values of n points (x[k], y[k], z) in single precision,
+	// 4, 8 or 16 at a time with the best instruction set up to level
+	void noise(const float * x, const float * y, float z, float * out, size_t n,
+		SimdLevel level = simdLevel()) const;
+	// Same for n points (x[k], y[k], z[k])
+	void noise(const float * x, const float * y, const float * z, float * out, size_t n,
+		SimdLevel level = simdLevel()) const;
+	// Get the noise values of n points (x[k], y[k]) on a number of planes in a
+	// single pass, plane c is at z[c][k] and its values go to out[c][k]
+	void noise(const float * x, const float * y, const float * const * z,
+		float * const * out, int planes, size_t n, SimdLevel level = simdLevel()) const;
+	// Get the noise values of 8 points
+	void noise8(const float * x, const float * y, float z, float * out) const;
 private:
-	double fade(double t);
-	double lerp(double t, double a, double b);
-	double grad(int hash, double x, double y, double z);
+	template <typename T> T evaluate(T x, T y, T z) const;
+	template <typename T> void evaluatePlanes(T x, T y, const T * z, T * out, int planes) const;
+	template <typename T> void evaluateRow(const T * x, T y, const T * z, T zs, T * out, size_t n) const;
+	template <typename T> static T fade(T t);
+	template <typename T> static T lerp(T t, T a, T b);
+	template <typename T> static T grad(int hash, T x, T y, T z);
+	void noiseBatch(const float * x, const float * y, const float * z, float zs,
+		float * out, size_t n, SimdLevel level) const;
 };
 
 #endif
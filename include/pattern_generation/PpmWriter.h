@@ -0,0 +1,61 @@
+#ifndef PPMWRITER_H
+#define PPMWRITER_H
+
+#include "pattern_generation/TileRenderer.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief      Writes a streamed image to a binary PPM file as its bands
+ *             arrive, so the image never needs to fit in memory. Pixels are
+ *             taken in OpenCV BGR order, as cv::imwrite does.
+ */
+class PpmWriter : public BandSink
+{
+    private:
+        /// Output file path
+        std::string path;
+        /// Output file
+        std::ofstream file;
+        /// One row reordered to RGB
+        std::vector<uchar> row;
+
+    public:
+
+        /**
+         * @brief      Constructor, the file is opened by begin().
+         *
+         * @param      path  The file path
+         */
+        explicit PpmWriter(const std::string & path);
+
+        /**
+         * @brief      Opens the file and writes the header.
+         *
+         * @param      size  The image size
+         */
+        void begin(const cv::Size & size);
+
+        /**
+         * @brief      Appends the rows of a band.
+         *
+         * @param      band    The 8-bit, 3 channel rows
+         * @param      band_y  The image row of the first band row
+         */
+        void writeBand(const cv::Mat & band, int band_y);
+
+        /**
+         * @brief      Closes the file.
+         */
+        void end();
+
+        /**
+         * @brief      Whether every write so far succeeded.
+         *
+         * @return     False after a failed open or write.
+         */
+        bool good() const;
+};
+
+#endif
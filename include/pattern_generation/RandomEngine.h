@@ -0,0 +1,120 @@
+#ifndef RANDOMENGINE_H
+#define RANDOMENGINE_H
+
+#include <cstdint>
+
+/**
+ * @brief      Small, seedable SplitMix64 generator.
+ *
+ *             The whole state is a single 64 bit counter, so engines are
+ *             cheap to create and copy. An engine derived from
+ *             (seed, index, stream) always yields the same sequence, which
+ *             lets any texture be regenerated on its own, in any order and
+ *             on any thread. Satisfies UniformRandomBitGenerator.
+ */
+class RandomEngine
+{
+    private:
+        uint64_t state;
+
+    public:
+        typedef uint64_t result_type;
+
+        /// SplitMix64 counter increment (2^64 / golden ratio)
+        static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+        /**
+         * @brief      Constructor
+         *
+         * @param      seed  The seed
+         */
+        explicit RandomEngine(uint64_t seed=0);
+
+        /**
+         * @brief      Constructs the engine of an independent stream.
+         *
+         * @param      seed    The global seed
+         * @param      index   The texture index
+         * @param      stream  The stream id within the texture
+         */
+        RandomEngine(uint64_t seed, uint64_t index, uint64_t stream);
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT64_MAX; }
+
+        /**
+         * @brief      Advances the engine.
+         *
+         * @return     The next 64 random bits.
+         */
+        result_type operator()()
+        {
+            state += GOLDEN_GAMMA;
+            return mix(state);
+        }
+
+        /**
+         * @brief      Draws an integer in [0, n).
+         *
+         * @param      n     The upper bound
+         *
+         * @return     The random integer.
+         */
+        uint32_t uniform(uint32_t n)
+        {
+            return (uint32_t) (((*this)() >> 32) * n >> 32);
+        }
+
+        /**
+         * @brief      Draws a real number in [0, 1).
+         *
+         * @return     The random number.
+         */
+        double uniformReal()
+        {
+            return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        /**
+         * @brief      Random access into the sequence, without advancing
+         *             the engine. at(k) equals the (k+1)-th value returned by
+         *             operator(), so threads can share one const engine and
+         *             each draw the values for the counters they own.
+         *
+         * @param      counter  The position in the sequence
+         *
+         * @return     The random bits at that position.
+         */
+        result_type at(uint64_t counter) const
+        {
+            return mix(state + (counter + 1) * GOLDEN_GAMMA);
+        }
+
+        /**
+         * @brief      Random access counterpart of uniformReal().
+         *
+         * @param      counter  The position in the sequence
+         *
+         * @return     The random number in [0, 1).
+         */
+        double uniformRealAt(uint64_t counter) const
+        {
+            return (at(counter) >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        /**
+         * @brief      SplitMix64 output function, a 64 bit bijective hash.
+         *
+         * @param      z     The value to hash
+         *
+         * @return     The hashed value.
+         */
+        static uint64_t mix(uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef TEXTUREARCHIVE_H
+#define TEXTUREARCHIVE_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief      Many encoded textures packed in a single append-only file.
+ *
+ *             Layout, in native byte order:
+ *             - the 8 byte MAGIC
+ *             - one record per texture, back to back: the RECORD tag, name
+ *               and params lengths (uint32), file size (uint64), then the
+ *               name, the params and the texture file
+ *
+ *             Writing a dataset creates one file instead of one per
+ *             texture, and reading it is a single memory mapping. Records
+ *             describe themselves, so an archive cut short by a crash still
+ *             reads up to its last complete record and can be appended to.
+ */
+namespace TextureArchive
+{
+    /// File signature, at the start of the archive
+    static const char MAGIC[8] = {'P', 'G', 'A', 'R', 'C', 'H', '0', '2'};
+
+    /// Tag starting every record
+    static const char RECORD[4] = {'P', 'G', 'T', 'X'};
+
+    /// A texture of an archive
+    struct Entry
+    {
+        /// File name, e.g. "perlin_12.jpg"
+        std::string name;
+        /// Generation parameters, free form
+        std::string params;
+        /// Offset of the texture file within the archive
+        uint64_t offset;
+        /// Size of the texture file
+        uint64_t size;
+    };
+}
+
+/**
+ * @brief      Appends textures to an archive. add() may be called from
+ *             several threads.
+ */
+class TextureArchiveWriter
+{
+    private:
+        /// Archive file
+        std::ofstream file;
+        /// Serializes add() and close()
+        std::mutex mutex;
+
+    public:
+
+        /**
+         * @brief      Opens an archive for appending, creating it when
+         *             missing. A record cut short by a crash is dropped
+         *             first, the complete ones are kept.
+         *
+         * @param      path  The archive path
+         */
+        explicit TextureArchiveWriter(const std::string & path);
+
+        /**
+         * @brief      Closes the archive if close() was not called.
+         */
+        ~TextureArchiveWriter();
+
+        /**
+         * @brief      Appends a texture file.
+         *
+         * @param      name    The file name
+         * @param      params  The generation parameters
+         * @param      data    The file contents
+         * @param      size    The file size
+         *
+         * @return     False when the archive could not be written.
+         */
+        bool add(const std::string & name, const std::string & params,
+            const void * data, std::size_t size);
+
+        /**
+         * @brief      Closes the archive.
+         *
+         * @return     False when the archive could not be opened or written.
+         */
+        bool close();
+};
+
+/**
+ * @brief      Memory maps an archive. Texture contents are read straight
+ *             from the mapping, without copies.
+ */
+class TextureArchiveReader
+{
+    private:
+        /// Archive file mapping
+        boost::interprocess::file_mapping mapping;
+        /// Whole archive mapped read only
+        boost::interprocess::mapped_region region;
+        /// Index
+        std::vector<TextureArchive::Entry> entries;
+        /// Position of every name in the index
+        std::unordered_map<std::string, std::size_t> names;
+
+    public:
+
+        /**
+         * @brief      Maps an archive and reads the header of every record.
+         *             A record cut short, e.g. by a crash while writing, and
+         *             whatever follows it are ignored.
+         *
+         * @param      path  The archive path
+         *
+         * @return     False when the file is missing or is not an archive.
+         */
+        bool open(const std::string & path);
+
+        /**
+         * @brief      Gets the textures of the archive.
+         *
+         * @return     The index, in the order textures were added.
+         */
+        const std::vector<TextureArchive::Entry> & getEntries() const;
+
+        /**
+         * @brief      Finds a texture by name, the last one added under it.
+         *
+         * @param      name  The file name
+         *
+         * @return     The entry, NULL when there is none.
+         */
+        const TextureArchive::Entry * find(const std::string & name) const;
+
+        /**
+         * @brief      Gets the contents of a texture file.
+         *
+         * @param      entry  The entry
+         *
+         * @return     The mapped bytes, entry.size of them.
+         */
+        const uint8_t * getData(const TextureArchive::Entry & entry) const;
+};
+
+#endif
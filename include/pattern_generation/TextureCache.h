@@ -0,0 +1,138 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <atomic>
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief      On-disk cache of encoded textures, addressed by a hash of the
+ *             full set of parameters they were generated with.
+ *
+ *             Every texture is one file named after the hash, holding the
+ *             parameter string and the encoded bytes; the string is compared
+ *             on lookup, so hash collisions are misses. The total size is
+ *             kept under a limit by evicting the least recently used files.
+ *             Recency survives between runs through the file modification
+ *             times, to the nanosecond. All methods may be called from
+ *             several threads.
+ */
+class TextureCache
+{
+    private:
+        /// A cached file
+        struct Item
+        {
+            /// Parameter hash
+            uint64_t hash;
+            /// File size
+            uint64_t size;
+        };
+
+        /// Cache directory
+        boost::filesystem::path directory;
+        /// Size limit in bytes
+        uint64_t max_size;
+        /// Size of the cached files
+        uint64_t size;
+        /// Cached files, the most recently used first
+        std::list<Item> lru;
+        /// Position of every hash in lru
+        std::unordered_map<uint64_t, std::list<Item>::iterator> items;
+        /// Guards size, lru and items
+        std::mutex mutex;
+        /// Counters
+        std::atomic<uint64_t> hits, misses, evictions;
+
+        /**
+         * @brief      Gets the file of a hash.
+         *
+         * @param      hash  The hash
+         *
+         * @return     The file path.
+         */
+        boost::filesystem::path getPath(uint64_t hash) const;
+
+        /**
+         * @brief      Removes the least recently used files until the size
+         *             is within the limit. Called with the mutex held.
+         */
+        void evict();
+
+    public:
+
+        /// File extension of the cached files
+        static const char * const EXTENSION;
+
+        /**
+         * @brief      Opens a cache directory, creating it if needed, removes
+         *             the temporary files of crashed runs and evicts files
+         *             until it is within the size limit. Temporary files of
+         *             live processes are kept unless older than an hour, so
+         *             several processes may share the directory.
+         *
+         * @param      directory  The directory
+         * @param      max_size   The size limit in bytes
+         */
+        TextureCache(const std::string & directory, uint64_t max_size);
+
+        /**
+         * @brief      Hashes a parameter string, FNV-1a 64.
+         *
+         * @param      params  The parameters
+         *
+         * @return     The hash.
+         */
+        static uint64_t hash(const std::string & params);
+
+        /**
+         * @brief      Looks up the texture generated with the given parameters.
+         *
+         * @param      params  The full parameter string
+         * @param      data    The encoded bytes, on a hit
+         *
+         * @return     True on a hit.
+         */
+        bool get(const std::string & params, std::vector<uint8_t> & data);
+
+        /**
+         * @brief      Stores the texture generated with the given parameters.
+         *             Textures larger than the size limit are not stored.
+         *
+         * @param      params  The full parameter string
+         * @param      data    The encoded bytes
+         * @param      length  The number of bytes
+         *
+         * @return     False when the texture is larger than the size limit or
+         *             could not be written.
+         */
+        bool put(const std::string & params, const void * data, std::size_t length);
+
+        /**
+         * @brief      Gets the number of hits.
+         */
+        uint64_t getHits() const;
+
+        /**
+         * @brief      Gets the number of misses.
+         */
+        uint64_t getMisses() const;
+
+        /**
+         * @brief      Gets the number of evicted files.
+         */
+        uint64_t getEvictions() const;
+
+        /**
+         * @brief      Gets the size of the cached files, in bytes.
+         */
+        uint64_t getSize();
+};
+
+#endif
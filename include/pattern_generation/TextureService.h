@@ -0,0 +1,326 @@
+#ifndef TEXTURESERVICE_H
+#define TEXTURESERVICE_H
+
+#include "pattern_generation/PatternGeneration.h"
+#include "pattern_generation/BoundedQueue.h"
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief      Protocol of the resident texture generator.
+ *
+ *             Clients connect to a local Unix socket and exchange fixed size
+ *             messages, in native byte order:
+ *             - on connection, the server sends a Hello naming its shared
+ *               memory ring, which the client maps read only
+ *             - a TEXTURE Request is answered by a Reply giving the slot of
+ *               the ring the pixels were drawn into, as 8-bit BGR rows
+ *               without padding
+ *             - a RELEASE Request hands a slot back, without a reply
+ *
+ *             Pixels are drawn straight into the ring and never copied or
+ *             encoded. A slot stays with its client until released or until
+ *             the client disconnects; requests are answered RING_FULL when
+ *             every slot is taken.
+ */
+namespace TextureService
+{
+    /// Hello signature, also the protocol version
+    static const char MAGIC[8] = {'P', 'G', 'S', 'E', 'R', 'V', '0', '1'};
+
+    /// Request types
+    enum Type { TEXTURE, RELEASE };
+
+    /// Reply status
+    enum Status {
+        /// Drawn into the slot
+        OK,
+        /// Every slot is held by a client
+        RING_FULL,
+        /// Larger than a slot
+        TOO_LARGE,
+        /// Unknown type or pattern, or invalid parameters
+        BAD_REQUEST
+    };
+
+    /// Sent by the server on connection
+    struct Hello
+    {
+        /// MAGIC
+        char magic[8];
+        /// Shared memory object of the ring, NUL terminated
+        char ring[64];
+        /// Number of slots and bytes per slot
+        uint64_t slots, slot_size;
+    };
+
+    /// A texture, as TextureSpec, or a released slot
+    struct Request
+    {
+        /// Type
+        uint32_t type;
+        /// Slot handed back, for RELEASE
+        uint32_t slot;
+        /// TextureSpec::Pattern
+        uint32_t pattern;
+        /// Image size
+        uint32_t width, height;
+        /// Chess square size
+        uint32_t block_size;
+        /// Gradient direction and Perlin color mode, 0 or 1
+        uint32_t vertical, random_colors;
+        /// FractalNoise::Type and octaves
+        uint32_t fractal_type, octaves;
+        /// Colors in Lab
+        double color1[3], color2[3];
+        /// Perlin channel planes
+        double z[3];
+        /// Noise lattice cells across the image, 0 for the pattern default
+        double frequency;
+        /// Fractal lacunarity and gain
+        double lacunarity, gain;
+        /// Texture index and stream id of the random engine, derived from
+        /// the server seed
+        uint64_t index, stream;
+    };
+
+    /// Answer to a TEXTURE request
+    struct Reply
+    {
+        /// Status
+        uint32_t status;
+        /// Slot holding the pixels
+        uint32_t slot;
+        /// Image size
+        uint32_t width, height;
+        /// Offset of the pixels in the ring, and their size
+        uint64_t offset, size;
+    };
+
+    /**
+     * @brief      Gets the request of a texture.
+     *
+     * @param      spec    The texture, its engine ignored
+     * @param      index   The texture index
+     * @param      stream  The stream id
+     *
+     * @return     The request.
+     */
+    Request makeRequest(const TextureSpec & spec, uint64_t index, uint64_t stream);
+
+    /**
+     * @brief      Gets the texture of a request.
+     *
+     * @param      request  The request
+     *
+     * @return     The texture, without its random engine.
+     */
+    TextureSpec getSpec(const Request & request);
+
+    /// A texture waiting for the render thread
+    struct RenderJob
+    {
+        /// The texture
+        TextureSpec spec;
+        /// Slot pixels
+        uchar * pixels;
+        /// Set once drawn, false when the texture could not be drawn
+        std::promise<bool> * done;
+    };
+}
+
+/**
+ * @brief      Resident texture generator. Serves clients over a Unix
+ *             socket, drawing into a shared memory ring. A single render
+ *             thread draws every texture, so that its OpenMP pool, the
+ *             permutation tables and the row buffers stay warm between
+ *             requests, and each texture gets every core.
+ */
+class TextureServer
+{
+    private:
+        /// Generator of every texture
+        const PatternGeneration & pattern_generation;
+        /// Socket file
+        std::string socket_path;
+        /// Shared memory object of the ring
+        std::string ring_name;
+        /// Number of slots and bytes per slot, a multiple of the page size
+        std::size_t slot_count, slot_size;
+        /// OpenMP threads of the render thread, 0 for the default
+        int threads;
+        /// Ring
+        boost::interprocess::shared_memory_object memory;
+        boost::interprocess::mapped_region region;
+        /// Listening socket, -1 when not started
+        int listener;
+        /// Set by stop()
+        std::atomic<bool> stopping;
+        /// Connection holding each slot, -1 when free
+        std::vector<int> owners;
+        /// Open connections
+        std::set<int> connections;
+        /// Guards owners and connections
+        std::mutex mutex;
+        /// Signalled when a client thread removes its connection
+        std::condition_variable disconnected;
+        /// Textures waiting for the render thread
+        BoundedQueue<TextureService::RenderJob> jobs;
+        /// Render thread
+        std::thread renderer;
+
+        /**
+         * @brief      Draws the queued textures until the queue is closed.
+         */
+        void render();
+
+        /**
+         * @brief      Answers the requests of a client until it disconnects,
+         *             then frees its slots.
+         *
+         * @param      connection  The client socket
+         */
+        void serve(int connection);
+
+        /**
+         * @brief      Draws a texture into a free slot.
+         *
+         * @param      connection  The client socket
+         * @param      request     The request
+         * @param      reply       The reply
+         */
+        void drawTexture(int connection, const TextureService::Request & request,
+            TextureService::Reply & reply);
+
+    public:
+
+        /**
+         * @brief      Constructor, nothing is created until start().
+         *
+         * @param      pattern_generation  The generator, with its seed,
+         *                                 precision and color space set
+         * @param      socket_path         The socket file
+         * @param      ring_name           The shared memory object name
+         * @param      slots               The number of slots
+         * @param      slot_size           The bytes per slot, at least the
+         *                                 width times height times 3 of the
+         *                                 largest texture
+         * @param      threads             The OpenMP threads drawing each
+         *                                 texture, 0 for the default
+         */
+        TextureServer(
+            const PatternGeneration & pattern_generation,
+            const std::string & socket_path,
+            const std::string & ring_name,
+            std::size_t slots,
+            std::size_t slot_size,
+            int threads = 0);
+
+        /**
+         * @brief      Stops serving, removing the socket file and the ring.
+         */
+        ~TextureServer();
+
+        /**
+         * @brief      Creates the ring and the socket, replacing stale ones
+         *             of the same names, and starts the render thread.
+         *
+         * @return     False when either could not be created.
+         */
+        bool start();
+
+        /**
+         * @brief      Accepts clients, each served by its own detached
+         *             thread, until stop() is called or the socket fails,
+         *             then waits for every client thread to end. Running
+         *             out of descriptors only pauses accepting.
+         */
+        void run();
+
+        /**
+         * @brief      Makes run() return, disconnecting every client. May be
+         *             called from any thread.
+         */
+        void stop();
+};
+
+/**
+ * @brief      Client of a TextureServer. Pixels are read in place from the
+ *             ring, valid until their slot is released.
+ */
+class TextureClient
+{
+    private:
+        /// Server socket, -1 when not connected
+        int connection;
+        /// Server greeting
+        TextureService::Hello hello;
+        /// Ring, mapped read only
+        boost::interprocess::shared_memory_object memory;
+        boost::interprocess::mapped_region region;
+
+    public:
+
+        TextureClient();
+
+        /**
+         * @brief      Disconnects, the server frees the slots still held.
+         */
+        ~TextureClient();
+
+        /**
+         * @brief      Connects to a server and maps its ring.
+         *
+         * @param      socket_path  The socket file
+         *
+         * @return     False when the server is not running or not a
+         *             TextureServer.
+         */
+        bool open(const std::string & socket_path);
+
+        /**
+         * @brief      Disconnects.
+         */
+        void close();
+
+        /**
+         * @brief      Requests a texture, waiting until it is drawn.
+         *
+         * @param      request  The request
+         * @param      reply    The reply, with the slot when its status is OK
+         *
+         * @return     False when the connection failed.
+         */
+        bool request(const TextureService::Request & request, TextureService::Reply & reply);
+
+        /**
+         * @brief      Gets the pixels of a texture.
+         *
+         * @param      reply  The reply, with status OK
+         *
+         * @return     The 8-bit, 3 channel pixels in the ring, read only.
+         */
+        cv::Mat getPixels(const TextureService::Reply & reply) const;
+
+        /**
+         * @brief      Hands a slot back to the server. Its pixels must not be
+         *             read afterwards.
+         *
+         * @param      reply  The reply of the texture
+         *
+         * @return     False when the connection failed.
+         */
+        bool release(const TextureService::Reply & reply);
+};
+
+#endif
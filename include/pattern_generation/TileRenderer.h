@@ -0,0 +1,227 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <opencv2/core.hpp>
+
+/**
+ * @brief      A pattern drawn one rectangular tile at a time. Tiles are
+ *             drawn concurrently, so drawTile() must only write the pixels
+ *             of its tile and must not modify the kernel.
+ */
+class TileKernel
+{
+    public:
+
+        virtual ~TileKernel() {}
+
+        /**
+         * @brief      Draws the pixels of one tile.
+         *
+         * @param      pixels  The image pixels from origin on: the whole
+         *                     image, a band of full width rows when it is
+         *                     streamed, or the rectangle of a region target
+         * @param      origin  The image coordinates of the first pixel
+         * @param      tile    The tile, in image coordinates within pixels
+         */
+        virtual void drawTile(cv::Mat & pixels, const cv::Point & origin,
+            const cv::Rect & tile) const = 0;
+
+        /**
+         * @brief      Whether tiles span whole rows. Kernels that only copy
+         *             memory gain nothing from a tile staying in cache, and
+         *             write fastest along whole rows.
+         *
+         * @return     False for tiles of the renderer size.
+         */
+        virtual bool fullWidth() const { return false; }
+};
+
+/**
+ * @brief      Receives a streamed image as consecutive bands of full width
+ *             rows, from top to bottom.
+ */
+class BandSink
+{
+    public:
+
+        virtual ~BandSink() {}
+
+        /**
+         * @brief      Called once before the first band.
+         *
+         * @param      size  The image size
+         */
+        virtual void begin(const cv::Size & size) {}
+
+        /**
+         * @brief      Receives the next band. The pixels are only valid
+         *             during the call.
+         *
+         * @param      band    The 8-bit, 3 channel rows
+         * @param      band_y  The image row of the first band row
+         */
+        virtual void writeBand(const cv::Mat & band, int band_y) = 0;
+
+        /**
+         * @brief      Called once after the last band.
+         */
+        virtual void end() {}
+};
+
+/**
+ * @brief      Where a texture is drawn: either an allocated image, a
+ *             rectangle of an image that is never drawn as a whole, or a sink
+ *             the image is streamed to, so that only one band of tiles is held
+ *             in memory.
+ */
+class RenderTarget
+{
+    private:
+        /// Pixels drawn in place, empty when streaming
+        cv::Mat texture;
+        /// Sink of the streamed bands, NULL when drawing in place
+        BandSink * sink;
+        /// Image size
+        cv::Size size;
+        /// Image coordinates of the first pixel drawn in place
+        cv::Point origin;
+
+    public:
+
+        /**
+         * @brief      Draws into an allocated 8-bit, 3 channel image.
+         *
+         * @param      texture  The image
+         */
+        explicit RenderTarget(cv::Mat & texture);
+
+        /**
+         * @brief      Streams an image of the given size to a sink.
+         *
+         * @param      size  The image size
+         * @param      sink  The sink
+         */
+        RenderTarget(const cv::Size & size, BandSink & sink);
+
+        /**
+         * @brief      Draws one rectangle of an image of the given size into
+         *             an allocated 8-bit, 3 channel image of the rectangle
+         *             size. Only its pixels are evaluated, and they are the
+         *             same as in the whole image.
+         *
+         * @param      size     The image size
+         * @param      texture  The pixels of the rectangle
+         * @param      origin   The image coordinates of its top left pixel
+         */
+        RenderTarget(const cv::Size & size, cv::Mat & texture, const cv::Point & origin);
+
+        /**
+         * @brief      Gets the image size.
+         *
+         * @return     The size.
+         */
+        cv::Size getSize() const;
+
+        /**
+         * @brief      Gets the rectangle of the image that is drawn.
+         *
+         * @return     The rectangle, the whole image unless drawing a region.
+         */
+        cv::Rect getRegion() const;
+
+        /**
+         * @brief      Gets the pixels drawn in place.
+         *
+         * @return     The pixels of the region, empty when streaming.
+         */
+        cv::Mat getTexture() const;
+
+        /**
+         * @brief      Gets the sink of the streamed bands.
+         *
+         * @return     The sink, NULL when drawing in place.
+         */
+        BandSink * getSink() const;
+};
+
+/**
+ * @brief      Splits images into tiles small enough to stay in the L2 cache
+ *             while they are drawn, and hands them out dynamically to the
+ *             OpenMP threads.
+ */
+class TileRenderer
+{
+    private:
+        /// Tile size in pixels
+        cv::Size tile_size;
+
+        /**
+         * @brief      Draws the tiles of a band or region.
+         *
+         * @param      kernel  The pattern kernel
+         * @param      pixels  The image pixels from origin on
+         * @param      origin  The image coordinates of the first pixel
+         */
+        void renderRegion(const TileKernel & kernel, cv::Mat & pixels,
+            const cv::Point & origin) const;
+
+    public:
+
+        /// Default tile size, 96 KB of 8-bit, 3 channel pixels
+        static const int DEFAULT_TILE_WIDTH = 256;
+        static const int DEFAULT_TILE_HEIGHT = 128;
+
+        /**
+         * @brief      Constructor
+         *
+         * @param      tile_size  The tile size, clipped to the image. A
+         *                        width of 0 makes every tile full width
+         */
+        explicit TileRenderer(const cv::Size & tile_size =
+            cv::Size(DEFAULT_TILE_WIDTH, DEFAULT_TILE_HEIGHT));
+
+        /**
+         * @brief      Sets the tile size.
+         *
+         * @param      tile_size  The tile size
+         */
+        void setTileSize(const cv::Size & tile_size);
+
+        /**
+         * @brief      Gets the tile size.
+         *
+         * @return     The tile size.
+         */
+        cv::Size getTileSize() const;
+
+        /**
+         * @brief      Gets the number of tiles an image is split into.
+         *
+         * @param      size  The image size
+         *
+         * @return     The number of tiles.
+         */
+        int getTileCount(const cv::Size & size) const;
+
+        /**
+         * @brief      Draws a whole image, tile by tile.
+         *
+         * @param      kernel   The pattern kernel
+         * @param      texture  The image
+         */
+        void render(const TileKernel & kernel, cv::Mat & texture) const;
+
+        /**
+         * @brief      Draws a whole image, or the rectangle of a region
+         *             target, into a target. Streamed images are drawn one
+         *             band of tile rows at a time into a reused buffer, so
+         *             memory is bounded by the image width times the tile
+         *             height.
+         *
+         * @param      kernel  The pattern kernel
+         * @param      target  The target
+         */
+        void render(const TileKernel & kernel, const RenderTarget & target) const;
+};
+
+#endif
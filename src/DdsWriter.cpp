@@ -0,0 +1,83 @@
+#include "pattern_generation/DdsWriter.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+// DDS_HEADER and DDS_PIXELFORMAT, as documented for Direct3D 9
+static const uint32_t DDS_MAGIC = 0x20534444;
+static const uint32_t DDS_HEADER_SIZE = 124;
+static const uint32_t DDS_PIXELFORMAT_SIZE = 32;
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PITCH = 0x8,
+    DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+// Fields are little endian, whatever the host
+static void putUint32(std::vector<uchar> & buffer, uint32_t value)
+{
+    for (int k = 0; k < 4; ++k)
+        buffer.push_back((uchar) (value >> (8 * k)));
+}
+
+bool encodeDds(const std::vector<cv::Mat> & levels, std::vector<uchar> & buffer)
+{
+    buffer.clear();
+    if (levels.empty())
+        return false;
+
+    size_t data_size = 0;
+    for (size_t k = 0; k < levels.size(); ++k) {
+        const cv::Mat & level = levels[k];
+        if (level.type() != CV_8UC3 || level.empty())
+            return false;
+        if (k > 0 && (level.cols != std::max(1, levels[k - 1].cols / 2) ||
+            level.rows != std::max(1, levels[k - 1].rows / 2)))
+            return false;
+        data_size += (size_t) level.cols * level.rows * 3;
+    }
+
+    const cv::Mat & top = levels[0];
+    buffer.reserve(4 + DDS_HEADER_SIZE + data_size);
+    putUint32(buffer, DDS_MAGIC);
+    putUint32(buffer, DDS_HEADER_SIZE);
+    putUint32(buffer, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PITCH | DDSD_PIXELFORMAT |
+        DDSD_MIPMAPCOUNT);
+    putUint32(buffer, top.rows);
+    putUint32(buffer, top.cols);
+    putUint32(buffer, top.cols * 3);
+    putUint32(buffer, 0);
+    putUint32(buffer, (uint32_t) levels.size());
+    for (int k = 0; k < 11; ++k)
+        putUint32(buffer, 0);
+
+    putUint32(buffer, DDS_PIXELFORMAT_SIZE);
+    putUint32(buffer, DDPF_RGB);
+    putUint32(buffer, 0);
+    putUint32(buffer, 24);
+    putUint32(buffer, 0xff0000);
+    putUint32(buffer, 0x00ff00);
+    putUint32(buffer, 0x0000ff);
+    putUint32(buffer, 0);
+
+    putUint32(buffer, DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP);
+    for (int k = 0; k < 4; ++k)
+        putUint32(buffer, 0);
+
+    // Levels from the largest, rows tightly packed
+    for (size_t k = 0; k < levels.size(); ++k)
+        for (int y = 0; y < levels[k].rows; ++y) {
+            const uchar * row = levels[k].ptr<uchar>(y);
+            buffer.insert(buffer.end(), row, row + levels[k].cols * 3);
+        }
+    return true;
+}
+
+bool writeDds(const std::string & path, const std::vector<cv::Mat> & levels)
+{
+    std::vector<uchar> buffer;
+    if (!encodeDds(levels, buffer))
+        return false;
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    return !file.fail();
+}
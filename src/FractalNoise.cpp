@@ -0,0 +1,132 @@
+#include "pattern_generation/FractalNoise.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Points per block of the row evaluation, the per octave buffers live on
+// the stack
+static const size_t BLOCK = 256;
+// Octaves whose lattice cells are at least this many points wide are
+// evaluated along rows, narrower ones with the vector batch
+static const float ROW_MIN_SPAN = 32.0f;
+// Ridged multifractal offset and weight gain, as in Musgrave's version
+static const float RIDGED_OFFSET = 1.0f;
+static const float RIDGED_WEIGHT_GAIN = 2.0f;
+// Mean of |n| and of (1 - |n|)^2 over improved Perlin noise n in [-1, 1],
+// the values octaves above the frequency limit add. That of n is 0
+static const float TURBULENCE_MEAN = 0.220f;
+static const float RIDGED_MEAN = 0.633f;
+
+// Shift of octave o is o times this, fractional steps so that no two
+// octaves have their lattice points at the same place
+static const float OCTAVE_SHIFT[3] = {0.6180340f, 0.4142136f, 0.7320508f};
+
+FractalNoise::FractalNoise(const PerlinNoise & noise, Type type, int octaves,
+    float lacunarity, float gain) :
+    base(noise),
+    type(type),
+    octaves(std::max(1, octaves)),
+    lacunarity(lacunarity),
+    gain(gain),
+    max_frequency(std::numeric_limits<float>::infinity())
+{
+}
+
+FractalNoise::FractalNoise(RandomEngine & engine, Type type, int octaves,
+    float lacunarity, float gain) :
+    base(engine),
+    type(type),
+    octaves(std::max(1, octaves)),
+    lacunarity(lacunarity),
+    gain(gain),
+    max_frequency(std::numeric_limits<float>::infinity())
+{
+}
+
+void FractalNoise::setMaxFrequency(float frequency) {
+    max_frequency = frequency;
+}
+
+float FractalNoise::noise(float x, float y, float z) const {
+    float out;
+    noiseBlock(&x, y, z, &out, 1);
+    return out;
+}
+
+void FractalNoise::noiseRow(const float * x, float y, float z, float * out, size_t n) const {
+    for (size_t k = 0; k < n; k += BLOCK)
+        noiseBlock(x + k, y, z, out + k, std::min(BLOCK, n - k));
+}
+
+void FractalNoise::noiseBlock(const float * x, float y, float z, float * out, size_t n) const {
+    float xo[BLOCK], yo[BLOCK], no[BLOCK], sum[BLOCK], weight[BLOCK];
+    std::fill(sum, sum + n, 0.0f);
+    std::fill(weight, weight + n, 1.0f);
+
+    float frequency = 1.0f, amplitude = 1.0f, total = 0.0f;
+    for (int o = 0; o < octaves; ++o) {
+        // Octaves above the limit are replaced by their mean, so that the
+        // band limited sum keeps the brightness of the full one
+        if (frequency > max_frequency) {
+            if (type == TURBULENCE) {
+                for (size_t k = 0; k < n; ++k)
+                    sum[k] += amplitude * TURBULENCE_MEAN;
+            } else if (type == RIDGED) {
+                for (size_t k = 0; k < n; ++k)
+                    sum[k] += amplitude * RIDGED_MEAN * weight[k];
+            }
+            total += amplitude;
+            frequency *= lacunarity;
+            amplitude *= gain;
+            continue;
+        }
+
+        const float ox = o * OCTAVE_SHIFT[0], oy = o * OCTAVE_SHIFT[1], oz = o * OCTAVE_SHIFT[2];
+        for (size_t k = 0; k < n; ++k)
+            xo[k] = x[k] * frequency + ox;
+        const float y_octave = y * frequency + oy;
+        const float z_octave = z + oz;
+
+        // Points per lattice cell over this block
+        float cells = std::abs(std::floor(xo[n - 1]) - std::floor(xo[0])) + 1.0f;
+        if (n >= ROW_MIN_SPAN * cells) {
+            base.noiseRow(xo, y_octave, z_octave, no, n);
+        } else {
+            std::fill(yo, yo + n, y_octave);
+            base.noise(xo, yo, z_octave, no, n);
+        }
+
+        // Noise in [-1, 1] from the [0, 1] value of PerlinNoise
+        switch (type) {
+        case TURBULENCE:
+            for (size_t k = 0; k < n; ++k)
+                sum[k] += amplitude * std::abs(2.0f * no[k] - 1.0f);
+            break;
+        case RIDGED:
+            for (size_t k = 0; k < n; ++k) {
+                float signal = RIDGED_OFFSET - std::abs(2.0f * no[k] - 1.0f);
+                signal *= signal * weight[k];
+                weight[k] = std::min(1.0f, std::max(0.0f, signal * RIDGED_WEIGHT_GAIN));
+                sum[k] += amplitude * signal;
+            }
+            break;
+        default:
+            for (size_t k = 0; k < n; ++k)
+                sum[k] += amplitude * (2.0f * no[k] - 1.0f);
+        }
+
+        total += amplitude;
+        frequency *= lacunarity;
+        amplitude *= gain;
+    }
+
+    // Normalize to [0, 1]
+    const float scale = 1.0f / total;
+    if (type == FBM) {
+        for (size_t k = 0; k < n; ++k)
+            out[k] = std::min(1.0f, std::max(0.0f, 0.5f * (sum[k] * scale + 1.0f)));
+    } else {
+        for (size_t k = 0; k < n; ++k)
+            out[k] = std::min(1.0f, std::max(0.0f, sum[k] * scale));
+    }
+}
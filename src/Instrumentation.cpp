@@ -0,0 +1,215 @@
+#include "pattern_generation/Instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace Instrumentation
+{
+
+namespace {
+
+std::atomic<bool> enabled_flag(false);
+
+// Stages never move once created, the registry only grows
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Stage> > stages;
+};
+
+Registry & registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+// Upper bound of a latency bucket, in seconds
+double bucketSeconds(int bucket)
+{
+    return std::ldexp(1.0, bucket) * 1e-9;
+}
+
+}
+
+Stage::Stage(const std::string & name) :
+    name(name)
+{
+    reset();
+}
+
+void Stage::add(int64_t nanoseconds, uint64_t count)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    items.fetch_add(count, std::memory_order_relaxed);
+    int64_t current = longest.load(std::memory_order_relaxed);
+    while (nanoseconds > current &&
+        !longest.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed));
+
+    // Bucket b holds durations from 2^(b-1) up to 2^b ns
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && (int64_t(1) << bucket) <= nanoseconds)
+        ++bucket;
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stage::reset()
+{
+    calls = 0;
+    total = 0;
+    longest = 0;
+    items = 0;
+    for (int b = 0; b < BUCKETS; ++b)
+        histogram[b] = 0;
+}
+
+const std::string & Stage::getName() const
+{
+    return name;
+}
+
+uint64_t Stage::getCalls() const
+{
+    return calls;
+}
+
+double Stage::getSeconds() const
+{
+    return total * 1e-9;
+}
+
+double Stage::getLongest() const
+{
+    return longest * 1e-9;
+}
+
+uint64_t Stage::getItems() const
+{
+    return items;
+}
+
+uint64_t Stage::getBucket(int bucket) const
+{
+    return histogram[bucket];
+}
+
+double Stage::getPercentile(double fraction) const
+{
+    uint64_t counts[BUCKETS], sum = 0;
+    for (int b = 0; b < BUCKETS; ++b)
+        sum += counts[b] = histogram[b];
+    if (sum == 0)
+        return 0;
+
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t) std::ceil(fraction * sum));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen >= rank)
+            return std::min(bucketSeconds(b), getLongest());
+    }
+    return getLongest();
+}
+
+bool enabled()
+{
+    return enabled_flag.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enable)
+{
+    enabled_flag = enable;
+}
+
+Stage & stage(const std::string & name)
+{
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::unique_ptr<Stage> & s : r.stages)
+        if (s->getName() == name)
+            return *s;
+    r.stages.emplace_back(new Stage(name));
+    return *r.stages.back();
+}
+
+std::vector<const Stage *> stages()
+{
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<const Stage *> result;
+    for (const std::unique_ptr<Stage> & s : r.stages)
+        result.push_back(s.get());
+    return result;
+}
+
+void reset()
+{
+    Registry & r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const std::unique_ptr<Stage> & s : r.stages)
+        s->reset();
+}
+
+void report(std::ostream & os)
+{
+    // Calls of a stage may run on several threads at once, its total is
+    // the busy time summed over them
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::left << std::setw(18) << "stage" << std::right << std::setw(10) << "calls"
+        << std::setw(12) << "total [s]" << std::setw(12) << "mean [ms]" << std::setw(12)
+        << "p50 [ms]" << std::setw(12) << "p99 [ms]" << std::setw(12) << "max [ms]"
+        << std::setw(14) << "items/s" << std::endl;
+    for (const Stage * s : stages()) {
+        const uint64_t calls = s->getCalls();
+        if (calls == 0)
+            continue;
+        const double seconds = s->getSeconds();
+        os << std::left << std::setw(18) << s->getName() << std::right << std::setw(10) << calls
+            << std::fixed << std::setprecision(3) << std::setw(12) << seconds
+            << std::setw(12) << seconds / calls * 1e3
+            << std::setw(12) << s->getPercentile(0.5) * 1e3
+            << std::setw(12) << s->getPercentile(0.99) * 1e3
+            << std::setw(12) << s->getLongest() * 1e3
+            << std::setprecision(0) << std::setw(14)
+            << (seconds > 0 ? s->getItems() / seconds : 0.0) << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void reportJson(std::ostream & os)
+{
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::setprecision(9) << "{\"stages\": [";
+    bool first = true;
+    for (const Stage * s : stages()) {
+        if (s->getCalls() == 0)
+            continue;
+        os << (first ? "\n" : ",\n") << "  {\"name\": \"" << s->getName()
+            << "\", \"calls\": " << s->getCalls() << ", \"seconds\": " << s->getSeconds()
+            << ", \"items\": " << s->getItems() << ", \"p50\": " << s->getPercentile(0.5)
+            << ", \"p99\": " << s->getPercentile(0.99) << ", \"max\": " << s->getLongest()
+            << ", \"histogram_ns\": {";
+        // Only the buckets with calls, keyed by their upper bound
+        bool first_bucket = true;
+        for (int b = 0; b < BUCKETS; ++b) {
+            if (s->getBucket(b) == 0)
+                continue;
+            os << (first_bucket ? "" : ", ") << "\"" << (int64_t(1) << b) << "\": "
+                << s->getBucket(b);
+            first_bucket = false;
+        }
+        os << "}}";
+        first = false;
+    }
+    os << "\n]}" << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}
@@ -1,160 +1,1213 @@
 #include "pattern_generation/PatternGeneration.h"
+#include "pattern_generation/Instrumentation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-PatternGeneration::PatternGeneration(){
-    dist=std::shared_ptr<std::uniform_int_distribution<int> > (new std::uniform_int_distribution<int> ());
+// Wood like structure, the fractional part of 20 times the noise value.
+// One helper per precision mode, the byte is floor(255 * fraction)
+
+static inline uchar woodDouble(double noise)
+{
+    double val = 20.0 * noise;
+    val = val - floor(val);
+    return (uchar) floor(255 * val);
 }
 
+static inline uchar woodFloat(float noise)
+{
+    float val = 20.0f * noise;
+    val = val - std::floor(val);
+    return (uchar) (255.0f * val);
+}
 
-cv::Scalar PatternGeneration::getRandomColor()
+static inline uchar woodFixed(int32_t noise)
+{
+    int32_t fraction = (20 * noise) & 0xFFFF;
+    return (uchar) ((fraction * 255) >> 16);
+}
+
+// Wraps a caller owned 8-bit, 3 channel buffer without copying it
+static cv::Mat wrapBuffer(uint8_t * data, int width, int height, size_t stride)
+{
+    return cv::Mat(height, width, CV_8UC3, data, stride);
+}
+
+// Converts Lab pixels to the given color space in place
+static void convertLab(cv::Vec3b * pixels, int n, PatternGeneration::ColorSpace color_space)
+{
+    if (color_space == PatternGeneration::COLOR_SPACE_LAB)
+        return;
+    INSTRUMENT_SCOPE("color_conversion", n);
+    cv::Mat lab(1, n, CV_8UC3, pixels);
+    cvtColor(lab,lab,cv::COLOR_Lab2RGB); // converting back to 8U with scaling
+}
+
+// Converts a Lab color to the given color space, saturated to 8 bits as
+// when filling the image
+static cv::Vec3b convertColor(const cv::Scalar & color, PatternGeneration::ColorSpace color_space)
+{
+    cv::Vec3b pixel(cv::saturate_cast<uchar>(color[0]),
+        cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+    convertLab(&pixel, 1, color_space);
+    return pixel;
+}
+
+// Per thread row buffers. They only ever grow, so once they have reached
+// the tile width generating a texture allocates nothing
+struct RowBuffers
+{
+    std::vector<double> xd, zd[3], nd[3];
+    std::vector<float> xs, zs[3], ns[3];
+    // Gradient colors, or the row patterns of flat and chess textures
+    std::vector<cv::Vec3b> colors;
+    // Share of the columns and rows of even squares in the pixels of a
+    // filtered chess board
+    std::vector<float> coverage[2];
+};
+
+static RowBuffers & rowBuffers()
+{
+    static thread_local RowBuffers buffers;
+    return buffers;
+}
+
+// Random stream of the Perlin permutation tables, apart from the ones
+// callers use for their textures
+static const uint64_t PERLIN_TABLE_STREAM = UINT64_MAX;
+
+// Prototype of the pool tables, copied rather than shuffled until a table
+// is first used
+static const PerlinNoise & unshuffledNoise()
 {
+    static const PerlinNoise noise;
+    return noise;
+}
+
+PatternGeneration::PatternGeneration() :
+    precision(PRECISION_DOUBLE),
+    color_space(COLOR_SPACE_RGB),
+    perlin_table_count(DEFAULT_PERLIN_TABLES)
+{
+    seedRandom();
+}
+
+PatternGeneration::PatternGeneration(uint64_t seed) :
+    precision(PRECISION_DOUBLE),
+    color_space(COLOR_SPACE_RGB),
+    perlin_table_count(DEFAULT_PERLIN_TABLES)
+{
+    setSeed(seed);
+}
+
+void PatternGeneration::setPrecision(Precision precision)
+{
+    this->precision = precision;
+}
+
+PatternGeneration::Precision PatternGeneration::getPrecision() const
+{
+    return precision;
+}
+
+void PatternGeneration::setColorSpace(ColorSpace color_space)
+{
+    this->color_space = color_space;
+}
+
+PatternGeneration::ColorSpace PatternGeneration::getColorSpace() const
+{
+    return color_space;
+}
+
+void PatternGeneration::setTileSize(const cv::Size & tile_size)
+{
+    renderer.setTileSize(tile_size);
+}
+
+cv::Size PatternGeneration::getTileSize() const
+{
+    return renderer.getTileSize();
+}
+
+void PatternGeneration::seedRandom()
+{
+    // The only entropy read, all random streams derive from this seed
     std::random_device rd;
-    std::mt19937 mt(rd());
+    setSeed(((uint64_t) rd() << 32) | rd());
+}
 
-    return cv::Scalar( (*dist)(mt)%255, (*dist)(mt)%255, (*dist)(mt)%255);
+void PatternGeneration::setSeed(uint64_t seed)
+{
+    this->seed = seed;
+    engine = RandomEngine(seed);
+    resetPerlinTables();
 }
 
-cv::Mat PatternGeneration::getChessTexture(
-    const cv::Scalar & color1,
-    const cv::Scalar & color2,
-    int blockSize,
-    int squares)
+void PatternGeneration::setPerlinTableCount(int count)
 {
-    int imageSize=blockSize*squares;
-    cv::Mat chessBoard(imageSize,imageSize,CV_8UC3,cv::Scalar::all(0));
+    perlin_table_count = std::max(0, count);
+    resetPerlinTables();
+}
 
-    cv::Scalar color_;
-    
+int PatternGeneration::getPerlinTableCount() const
+{
+    return perlin_table_count;
+}
 
-    for (int i=0;i<imageSize;i=i+blockSize){
-        for (int j=0;j<imageSize;j=j+blockSize){
-            cv::Mat ROI=chessBoard(cv::Rect(i,j,blockSize,blockSize));
-            if ((i+j) % 2 == 0) {
-                color_ = color1;
-            }
-            else {
-                color_=color2;
-            
+void PatternGeneration::resetPerlinTables()
+{
+    // Allocated here so that picking a table never allocates, and shuffled
+    // on first use so that setting the seed costs no shuffle
+    perlin_tables.reset();
+    if (perlin_table_count == 0)
+        return;
+    perlin_tables = std::make_shared<PerlinTables>();
+    perlin_tables->tables.assign(perlin_table_count, unshuffledNoise());
+    perlin_tables->shuffled = std::vector<std::once_flag>(perlin_table_count);
+}
+
+uint64_t PatternGeneration::getSeed() const
+{
+    return seed;
+}
+
+RandomEngine PatternGeneration::getRandomEngine(uint64_t index, uint64_t stream) const
+{
+    return RandomEngine(seed, index, stream);
+}
+
+cv::Scalar PatternGeneration::getRandomColor()
+{
+    return getRandomColor(engine);
+}
+
+cv::Scalar PatternGeneration::getRandomColor(RandomEngine & rng)
+{
+    INSTRUMENT_SCOPE("random_color", 1);
+    double l = rng.uniform(255);
+    double a = rng.uniform(255);
+    double b = rng.uniform(255);
+    return cv::Scalar(l, a, b);
+}
+
+// Per tile kernels of the patterns, the colors are converted beforehand
+// or one tile row at a time while it is in cache
+namespace {
+
+// Flat and chess textures are memory fills: their rows are copies of row
+// patterns as wide as the region drawn, built once per texture by the
+// calling thread, and only read by the tile kernels. The patterns start at
+// the first column of the region, which is that of the pixels drawn into
+// as bands are full width. Their tiles are whole rows, so that each thread
+// writes one contiguous range
+
+// Fills larger than this, about a last level cache, bypass the cache: the
+// pixels would be evicted before being read anyway, and plain stores first
+// read every line they write, halving the bandwidth
+const size_t STREAM_FILL_BYTES = 8 << 20;
+
+// Copies a pattern row, through non-temporal stores when streaming
+static inline void copyRow(uchar * dst, const uchar * src, size_t bytes, bool stream)
+{
+#ifdef __SSE2__
+    if (stream) {
+        const size_t head = std::min(bytes, (size_t) (-(uintptr_t) dst & 15));
+        std::memcpy(dst, src, head);
+        size_t k = head;
+        for (; k + 16 <= bytes; k += 16)
+            _mm_stream_si128(reinterpret_cast<__m128i *>(dst + k),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + k)));
+        std::memcpy(dst + k, src + k, bytes - k);
+        return;
+    }
+#endif
+    (void) stream;
+    std::memcpy(dst, src, bytes);
+}
+
+// Orders the non-temporal stores of a tile before the renderer joins its
+// threads
+static inline void endStream(bool stream)
+{
+#ifdef __SSE2__
+    if (stream)
+        _mm_sfence();
+#endif
+    (void) stream;
+}
+
+class FlatKernel : public TileKernel
+{
+    const cv::Vec3b * pattern;
+    bool stream;
+public:
+    FlatKernel(const cv::Vec3b * pattern, bool stream) :
+        pattern(pattern), stream(stream) {}
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        for (int y = tile.y; y < tile.y + tile.height; ++y)
+            copyRow(pixels.ptr<uchar>(y - origin.y) + 3 * (tile.x - origin.x),
+                reinterpret_cast<const uchar *>(pattern + tile.x - origin.x),
+                tile.width * sizeof(cv::Vec3b), stream);
+        endStream(stream);
+    }
+
+    bool fullWidth() const { return true; }
+};
+
+class ChessKernel : public TileKernel
+{
+    // Rows of the squares whose top row j is even and odd
+    const cv::Vec3b * patterns[2];
+    int blockSize;
+    // Image rows are scaled to board rows, when drawn at another size
+    int64_t rows, board_rows;
+    bool stream;
+public:
+    ChessKernel(const cv::Vec3b * even, const cv::Vec3b * odd, int blockSize, int rows,
+        int board_rows, bool stream) :
+        blockSize(blockSize), rows(rows), board_rows(board_rows), stream(stream)
+    {
+        patterns[0] = even;
+        patterns[1] = odd;
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            const int board_y = (int) (y * board_rows / rows);
+            const int j = board_y - board_y % blockSize;
+            copyRow(pixels.ptr<uchar>(y - origin.y) + 3 * (tile.x - origin.x),
+                reinterpret_cast<const uchar *>(patterns[j % 2] + tile.x - origin.x),
+                tile.width * sizeof(cv::Vec3b), stream);
+        }
+        endStream(stream);
+    }
+
+    bool fullWidth() const { return true; }
+};
+
+// Chess board filtered to a mip level: a pixel covers ex of even square
+// columns and ey of even square rows, so it blends the even squares color
+// with weight ex * ey + (1 - ex) * (1 - ey)
+class ChessBlendKernel : public TileKernel
+{
+    float colors[2][3];
+    // Coverage of the region columns and rows
+    const float * ex;
+    const float * ey;
+public:
+    ChessBlendKernel(const cv::Vec3b & even, const cv::Vec3b & odd, const float * ex,
+        const float * ey) :
+        ex(ex), ey(ey)
+    {
+        for (int c = 0; c < 3; ++c) {
+            colors[0][c] = even[c];
+            colors[1][c] = odd[c];
+        }
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(y - origin.y) + tile.x - origin.x;
+            const float fy = ey[y - origin.y];
+            for (int x = 0; x < tile.width; ++x) {
+                const float fx = ex[tile.x - origin.x + x];
+                const float f = fx * fy + (1.0f - fx) * (1.0f - fy);
+                for (int c = 0; c < 3; ++c)
+                    row[x][c] = cv::saturate_cast<uchar>(
+                        colors[1][c] + f * (colors[0][c] - colors[1][c]));
             }
-            ROI.setTo(color_);
         }
     }
+};
 
+// First texture pixel averaged by pixel i of a mip level, along an axis of
+// length texture pixels and steps level pixels
+static inline int boxStart(int i, int length, int steps)
+{
+    return (int) ((int64_t) i * length / steps);
+}
 
-    cvtColor(chessBoard,chessBoard,cv::COLOR_Lab2RGB); // converting back to 8U with scaling
-    return chessBoard;
+// Share of the box of each of count level pixels from first on that falls
+// on squares of even column or row index, with the parity of render()
+static void chessCoverage(float * coverage, int first, int count, int steps, int length,
+    int block_size)
+{
+    for (int i = 0; i < count; ++i) {
+        const int begin = boxStart(first + i, length, steps);
+        const int end = boxStart(first + i + 1, length, steps);
+        int even = 0;
+        for (int x = begin; x < end; ++x)
+            even += (x - x % block_size) % 2 == 0;
+        coverage[i] = (float) even / (end - begin);
+    }
 }
 
-cv::Mat PatternGeneration::getFlatTexture(const cv::Scalar & color, const int & imageSize)
+// Gradient colors are one per row or column of the region, from the
+// image row or column first on
+template <bool Vertical>
+class GradientKernel : public TileKernel
 {
-    cv::Mat flat(imageSize,imageSize,CV_8UC3,color);
-    cvtColor(flat,flat,cv::COLOR_Lab2RGB); // converting back to 8U with scaling
-    return flat;
+    const cv::Vec3b * colors;
+    int first;
+public:
+    GradientKernel(const cv::Vec3b * colors, int first) :
+        colors(colors), first(first) {}
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        for (int y = tile.y; y < tile.y + tile.height; ++y) {
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(y - origin.y) + tile.x - origin.x;
+            if (Vertical)
+                std::fill(row, row + tile.width, colors[y - first]);
+            else
+                std::copy(colors + tile.x - first, colors + tile.x - first + tile.width, row);
+        }
+    }
+};
+
+// The row buffers and wood helper of each floating point precision
+template <typename T>
+struct NoiseRows
+{
+    std::vector<T> & x;
+    std::vector<T> * z;
+    std::vector<T> * n;
+};
+
+static inline NoiseRows<double> noiseRows(RowBuffers & buffers, double)
+{
+    NoiseRows<double> rows = {buffers.xd, buffers.zd, buffers.nd};
+    return rows;
 }
 
-cv::Mat PatternGeneration::getGradientTexture(
-    const cv::Scalar & color1,
-    const cv::Scalar & color2,
-    const int & imageSize,
-    bool vertical)
+static inline NoiseRows<float> noiseRows(RowBuffers & buffers, float)
 {
-    cv::Mat gradient(imageSize,imageSize,CV_8UC3,cv::Scalar::all(0));
+    NoiseRows<float> rows = {buffers.xs, buffers.zs, buffers.ns};
+    return rows;
+}
 
-    cv::Scalar gradient_step(color1-color2);
+static inline uchar wood(double noise) { return woodDouble(noise); }
+static inline uchar wood(float noise) { return woodFloat(noise); }
 
-    if(vertical)
+// Perlin kernels are specialized on the precision and on whether the z of
+// every pixel is random, so that their loops carry no per row or per pixel
+// mode checks. Random colors are drawn by random access into a private
+// stream, with one counter per pixel channel. Threads share nothing
+// mutable, and the result does not depend on the number of threads or the
+// tiling
+template <typename T, bool RandomColors>
+class PerlinKernel : public TileKernel
+{
+    const PerlinNoise & pn;
+    RandomEngine pixel_rng;
+    T z[3];
+    double frequency;
+    int width;
+    PatternGeneration::ColorSpace color_space;
+public:
+    PerlinKernel(const PerlinNoise & pn, const RandomEngine & pixel_rng, const double z[3],
+        double frequency, int width, PatternGeneration::ColorSpace color_space) :
+        pn(pn), pixel_rng(pixel_rng), frequency(frequency), width(width),
+        color_space(color_space)
     {
-        #pragma omp parallel for
-        for(int y = 0; y < imageSize; y++)
-        {
-            cv::Vec3b val;
+        for (int c = 0; c < 3; ++c)
+            this->z[c] = (T) z[c];
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        // Lattice cells are square, frequency of them across the image width
+        const int n = tile.width;
+
+        // Per thread row buffers, x coordinates plus one z and one noise row
+        // per channel. The row evaluator works out the corner gradients once
+        // per lattice cell. The z rows are sized even when unused, so that
+        // switching color modes does not allocate
+        NoiseRows<T> rows = noiseRows(rowBuffers(), T());
+        rows.x.resize(n);
+        for (int c = 0; c < 3; ++c) {
+            rows.z[c].resize(n);
+            rows.n[c].resize(n);
+        }
+        for (int j = 0; j < n; ++j)
+            rows.x[j] = (T)(frequency * (tile.x + j))/((T)width);
+
+        for (int i = tile.y; i < tile.y + tile.height; ++i) {   // y
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(i - origin.y) + tile.x - origin.x;
+            T y = (T)(frequency * i)/((T)width);
+
+            if (RandomColors) {
+                const uint64_t row_counter = ((uint64_t) i * width + tile.x) * 3;
+                for (int j = 0; j < n; ++j)
+                    for (int c = 0; c < 3; ++c)
+                        rows.z[c][j] = (T) pixel_rng.uniformRealAt(row_counter + j * 3 + c);
+                for (int c = 0; c < 3; ++c)
+                    pn.noiseRow(rows.x.data(), y, rows.z[c].data(), rows.n[c].data(), n);
+            } else {
+                for (int c = 0; c < 3; ++c)
+                    pn.noiseRow(rows.x.data(), y, z[c], rows.n[c].data(), n);
+            }
+            for (int j = 0; j < n; ++j)
+                for (int c = 0; c < 3; ++c)
+                    row[j][c] = wood(rows.n[c][j]);
 
-            val[0] = color1[0]-y*gradient_step[0]/imageSize;
-            val[1] = color1[1]-y*gradient_step[1]/imageSize;
-            val[2] = color1[2]-y*gradient_step[2]/imageSize;
-            for(int x = 0; x < imageSize; x++)
-                gradient.at<cv::Vec3b>(y,x) = val;
+            convertLab(row, n, color_space);
         }
     }
+};
+
+template <bool RandomColors>
+class PerlinFixedKernel : public TileKernel
+{
+    const PerlinNoise & pn;
+    RandomEngine pixel_rng;
+    int32_t z[3];
+    double frequency;
+    int width;
+    PatternGeneration::ColorSpace color_space;
+public:
+    PerlinFixedKernel(const PerlinNoise & pn, const RandomEngine & pixel_rng, const double z[3],
+        double frequency, int width, PatternGeneration::ColorSpace color_space) :
+        pn(pn), pixel_rng(pixel_rng), frequency(frequency), width(width),
+        color_space(color_space)
+    {
+        for (int c = 0; c < 3; ++c)
+            this->z[c] = (int32_t) lrint(z[c] * 65536);
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        const int n = tile.width;
+
+        for (int i = tile.y; i < tile.y + tile.height; ++i) {   // y
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(i - origin.y) + tile.x - origin.x;
+            const uint64_t row_counter = ((uint64_t) i * width + tile.x) * 3;
+            int32_t y = (int32_t) ((((int64_t) i << 16) * frequency) / width);
+
+            for (int j = 0; j < n; ++j) {           // x
+                int32_t x = (int32_t) ((((int64_t) (tile.x + j) << 16) * frequency) / width);
+                int32_t zf[3], nf[3];
+                for (int c = 0; c < 3; ++c)
+                    zf[c] = RandomColors ?
+                        (int32_t) lrint(pixel_rng.uniformRealAt(row_counter + j * 3 + c) * 65536) :
+                        z[c];
+                pn.noiseFixed(x, y, zf, nf, 3);
+                for (int c = 0; c < 3; ++c)
+                    row[j][c] = woodFixed(nf[c]);
+            }
+
+            convertLab(row, n, color_space);
+        }
+    }
+};
+
+// Widest share of a Perlin lattice cell over which a mip level pixel takes
+// the noise as linear
+static const double MAX_LINEAR_CELLS = 1.0 / 64;
+
+// Integral of the wood ring sawtooth, frac(v), from 0 to v
+static inline double sawtoothIntegral(double v)
+{
+    const double f = v - floor(v);
+    return 0.5 * (floor(v) + f * f);
+}
+
+// Integral of sawtoothIntegral() from 0 to v
+static inline double sawtoothIntegral2(double v)
+{
+    const double f = v - floor(v);
+    return 0.25 * v * v - floor(v) / 12.0 + f * f * f / 6.0 - 0.25 * f * f;
+}
+
+// Wood ring of a pixel over which 20 times the noise, the ring count, rises
+// linearly from v by across and down from one corner to the next: the
+// sawtooth averaged over the pixel square, or over its edge when the rise
+// is along one axis only, from 0 to 1. No rise at all is woodDouble()
+static inline double ringAverage(double v, double across, double down)
+{
+    const double MIN_RISE = 1e-3;
+    if (std::abs(across) < std::abs(down))
+        std::swap(across, down);
+    double val;
+    if (std::abs(across) < MIN_RISE)
+        val = v - floor(v);
+    else if (std::abs(down) < MIN_RISE)
+        val = (sawtoothIntegral(v + across) - sawtoothIntegral(v)) / across;
     else
+        val = (sawtoothIntegral2(v + across + down) - sawtoothIntegral2(v + across) -
+            sawtoothIntegral2(v + down) + sawtoothIntegral2(v)) / (across * down);
+    return std::min(std::max(val, 0.0), 1.0);
+}
+
+// Perlin noise with fixed colors drawn as a mip level. The wood rings are
+// far finer than the lattice cells, so rather than leaving out frequencies
+// as fractal noise does, every pixel averages the rings over the noise it
+// covers, taken as linear from the differences to the next pixel across and
+// down. Where a pixel covers too much of a lattice cell for the noise to be
+// linear over it, it is split into samples x samples parts averaged
+// together. Evaluated in double whatever the precision
+class PerlinFilteredKernel : public TileKernel
+{
+    const PerlinNoise & pn;
+    double z[3];
+    double frequency;
+    int width;
+    int samples;
+    PatternGeneration::ColorSpace color_space;
+public:
+    PerlinFilteredKernel(const PerlinNoise & pn, const double z[3], double frequency, int width,
+        int samples, PatternGeneration::ColorSpace color_space) :
+        pn(pn), frequency(frequency), width(width), samples(samples), color_space(color_space)
     {
-        #pragma omp parallel for
-        for(int x = 0; x < imageSize; x++)
-        {
-            cv::Vec3b val;
+        std::copy(z, z + 3, this->z);
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        // One more column and row of parts than the tile, for the
+        // differences. The noise of the part row below goes in the z
+        // buffers, unused with fixed colors, and becomes the current row on
+        // the next one. The part averages add up in the float row buffers
+        const int n = tile.width * samples + 1;
+        const double scale = frequency / ((double) width * samples);
+        RowBuffers & buffers = rowBuffers();
+        std::vector<double> & x = buffers.xd, * current = buffers.nd, * below = buffers.zd;
+        std::vector<float> & sums = buffers.xs;
+        x.resize(n);
+        sums.resize(3 * tile.width);
+        for (int c = 0; c < 3; ++c) {
+            current[c].resize(n);
+            below[c].resize(n);
+        }
+        for (int j = 0; j < n; ++j)
+            x[j] = scale * ((int64_t) tile.x * samples + j);
+
+        for (int c = 0; c < 3; ++c)
+            pn.noiseRow(x.data(), scale * ((int64_t) tile.y * samples), z[c],
+                current[c].data(), n);
+        for (int i = tile.y; i < tile.y + tile.height; ++i) {   // y
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(i - origin.y) + tile.x - origin.x;
+            std::fill(sums.begin(), sums.end(), 0.0f);
+            for (int k = 1; k <= samples; ++k) {
+                for (int c = 0; c < 3; ++c)
+                    pn.noiseRow(x.data(), scale * ((int64_t) i * samples + k), z[c],
+                        below[c].data(), n);
+                for (int j = 0; j + 1 < n; ++j)
+                    for (int c = 0; c < 3; ++c) {
+                        const double v = 20.0 * current[c][j];
+                        sums[j / samples * 3 + c] += (float) ringAverage(v,
+                            20.0 * current[c][j + 1] - v, 20.0 * below[c][j] - v);
+                    }
+                for (int c = 0; c < 3; ++c)
+                    current[c].swap(below[c]);
+            }
+            for (int j = 0; j < tile.width; ++j)
+                for (int c = 0; c < 3; ++c)
+                    row[j][c] = (uchar) std::min(255.0f,
+                        std::floor(255.0f * sums[j * 3 + c] / (samples * samples)));
+            convertLab(row, tile.width, color_space);
+        }
+    }
+};
+
+typedef void (*PerlinRenderer)(const TileRenderer & renderer, const PerlinNoise & pn,
+    const RandomEngine & pixel_rng, const double z[3], double frequency,
+    PatternGeneration::ColorSpace color_space, const RenderTarget & target);
+
+template <typename Kernel>
+void renderPerlin(const TileRenderer & renderer, const PerlinNoise & pn,
+    const RandomEngine & pixel_rng, const double z[3], double frequency,
+    PatternGeneration::ColorSpace color_space, const RenderTarget & target)
+{
+    renderer.render(Kernel(pn, pixel_rng, z, frequency, target.getSize().width, color_space),
+        target);
+}
+
+// Every Perlin kernel instantiation, by precision and random colors
+const PerlinRenderer PERLIN_RENDERERS[3][2] = {
+    {&renderPerlin<PerlinKernel<double, false> >, &renderPerlin<PerlinKernel<double, true> >},
+    {&renderPerlin<PerlinKernel<float, false> >, &renderPerlin<PerlinKernel<float, true> >},
+    {&renderPerlin<PerlinFixedKernel<false> >, &renderPerlin<PerlinFixedKernel<true> >}
+};
+
+class FractalKernel : public TileKernel
+{
+    const FractalNoise & fn;
+    float z[3];
+    double frequency;
+    int width;
+    PatternGeneration::ColorSpace color_space;
+public:
+    FractalKernel(const FractalNoise & fn, const float z[3], double frequency, int width,
+        PatternGeneration::ColorSpace color_space) :
+        fn(fn), frequency(frequency), width(width), color_space(color_space)
+    {
+        std::copy(z, z + 3, this->z);
+    }
+
+    void drawTile(cv::Mat & pixels, const cv::Point & origin, const cv::Rect & tile) const
+    {
+        const int n = tile.width;
+
+        RowBuffers & buffers = rowBuffers();
+        std::vector<float> & xs = buffers.xs, * ns = buffers.ns;
+        xs.resize(n);
+        for (int c = 0; c < 3; ++c)
+            ns[c].resize(n);
+        for (int j = 0; j < n; ++j)
+            xs[j] = (float)(frequency * (tile.x + j))/((float)width);
 
-            val[0] = color1[0]-x*gradient_step[0]/imageSize;
-            val[1] = color1[1]-x*gradient_step[1]/imageSize;
-            val[2] = color1[2]-x*gradient_step[2]/imageSize;
-            for(int y = 0; y < imageSize; y++)
-                gradient.at<cv::Vec3b>(y,x) = val;
+        for (int i = tile.y; i < tile.y + tile.height; ++i) {   // y
+            cv::Vec3b * row = pixels.ptr<cv::Vec3b>(i - origin.y) + tile.x - origin.x;
+            float y = (float)(frequency * i)/((float)width);
+            for (int c = 0; c < 3; ++c)
+                fn.noiseRow(xs.data(), y, z[c], ns[c].data(), n);
+            for (int j = 0; j < n; ++j)
+                for (int c = 0; c < 3; ++c)
+                    row[j][c] = (uchar) (255.0f * ns[c][j]);
+            convertLab(row, n, color_space);
         }
     }
+};
+
+}
+
+cv::Mat PatternGeneration::getChessTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    int blockSize,
+    int squares)
+{
+    int imageSize=blockSize*squares;
+    cv::Mat chessBoard(imageSize,imageSize,CV_8UC3);
+    getChessTexture(color1, color2, blockSize, chessBoard);
+    return chessBoard;
+}
+
+void PatternGeneration::getChessTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    int blockSize,
+    cv::Mat & texture)
+{
+    getChessTexture(color1, color2, blockSize, RenderTarget(texture));
+}
+
+void PatternGeneration::getChessTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    int blockSize,
+    const RenderTarget & target)
+{
+    TextureSpec spec(TextureSpec::CHESS, target.getSize());
+    spec.color1 = color1;
+    spec.color2 = color2;
+    spec.block_size = blockSize;
+    getProceduralTexture(spec).render(target);
+}
+
+void PatternGeneration::getChessTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    int blockSize,
+    uint8_t * data,
+    int width,
+    int height,
+    size_t stride)
+{
+    cv::Mat texture = wrapBuffer(data, width, height, stride);
+    getChessTexture(color1, color2, blockSize, texture);
+}
+
+cv::Mat PatternGeneration::getFlatTexture(const cv::Scalar & color, const int & imageSize)
+{
+    cv::Mat flat(imageSize,imageSize,CV_8UC3);
+    getFlatTexture(color, flat);
+    return flat;
+}
+
+void PatternGeneration::getFlatTexture(const cv::Scalar & color, cv::Mat & texture)
+{
+    getFlatTexture(color, RenderTarget(texture));
+}
+
+void PatternGeneration::getFlatTexture(const cv::Scalar & color, const RenderTarget & target)
+{
+    TextureSpec spec(TextureSpec::FLAT, target.getSize());
+    spec.color1 = color;
+    getProceduralTexture(spec).render(target);
+}
 
-    cvtColor(gradient,gradient,cv::COLOR_Lab2RGB); // converting back to 8U with scaling
+void PatternGeneration::getFlatTexture(
+    const cv::Scalar & color,
+    uint8_t * data,
+    int width,
+    int height,
+    size_t stride)
+{
+    cv::Mat texture = wrapBuffer(data, width, height, stride);
+    getFlatTexture(color, texture);
+}
+
+cv::Mat PatternGeneration::getGradientTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    const int & imageSize,
+    bool vertical)
+{
+    cv::Mat gradient(imageSize,imageSize,CV_8UC3);
+    getGradientTexture(color1, color2, gradient, vertical);
     return gradient;
 }
 
+void PatternGeneration::getGradientTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    cv::Mat & texture,
+    bool vertical)
+{
+    getGradientTexture(color1, color2, RenderTarget(texture), vertical);
+}
+
+void PatternGeneration::getGradientTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    const RenderTarget & target,
+    bool vertical)
+{
+    TextureSpec spec(TextureSpec::GRADIENT, target.getSize());
+    spec.color1 = color1;
+    spec.color2 = color2;
+    spec.vertical = vertical;
+    getProceduralTexture(spec).render(target);
+}
+
+void PatternGeneration::getGradientTexture(
+    const cv::Scalar & color1,
+    const cv::Scalar & color2,
+    uint8_t * data,
+    int width,
+    int height,
+    size_t stride,
+    bool vertical)
+{
+    cv::Mat texture = wrapBuffer(data, width, height, stride);
+    getGradientTexture(color1, color2, texture, vertical);
+}
+
 cv::Mat PatternGeneration::getPerlinNoiseTexture(
     const int & imageSize,
     const bool & random_colors,
     const double & z1,
     const double & z2,
     const double & z3)
+{
+    return getPerlinNoiseTexture(imageSize, engine, random_colors, z1, z2, z3);
+}
+
+cv::Mat PatternGeneration::getPerlinNoiseTexture(
+    const int & imageSize,
+    RandomEngine & rng,
+    const bool & random_colors,
+    const double & z1,
+    const double & z2,
+    const double & z3,
+    const double & frequency)
 {
     // Create an empty PPM image
-    cv::Mat image(imageSize,imageSize,CV_8UC3,cv::Scalar::all(0));
-    // Create a PerlinNoise object with a random permutation vector generated with seed
-    //unsigned int seed = (*dist)(mt);
-    PerlinNoise pn;
+    cv::Mat image(imageSize,imageSize,CV_8UC3);
+    getPerlinNoiseTexture(rng, image, random_colors, z1, z2, z3, frequency);
+    return image;
+}
 
-    std::random_device rd;
-    std::mt19937 mt(rd());
-
-    // Visit every pixel of the image and assign a color generated with Perlin noise
-    #pragma omp parallel for
-    for (int i = 0; i < imageSize; ++i) {      // y
-        for (int j = 0; j < imageSize; ++j) {  // x
-
-            double x = (double)j/((double)imageSize);
-            double y = (double)i/((double)imageSize);
-
-            cv::Vec3d val;
-
-            // Wood like structure
-            if(random_colors)
-            {
-                // Red
-                val[0] = 20.0 * pn.noise(x, y, ((double) (*dist)(mt) / (RAND_MAX)));
-                val[0] = val[0] - floor(val[0]);
-                val[0] = floor(255 * val[0]);
-                // Green
-                val[1] = 20.0 * pn.noise(x, y, ((double) (*dist)(mt) / (RAND_MAX)));
-                val[1] = val[1] - floor(val[1]);
-                val[1] = floor(255 * val[1]);
-                // Blue
-                val[2] = 20.0 * pn.noise(x, y, ((double) (*dist)(mt) / (RAND_MAX)));
-                val[2] = val[2] - floor(val[2]);
-                val[2] = floor(255 * val[2]);
+void PatternGeneration::getPerlinNoiseTexture(
+    RandomEngine & rng,
+    cv::Mat & texture,
+    const bool & random_colors,
+    const double & z1,
+    const double & z2,
+    const double & z3,
+    const double & frequency)
+{
+    getPerlinNoiseTexture(rng, RenderTarget(texture), random_colors, z1, z2, z3, frequency);
+}
 
-            } else {
+void PatternGeneration::getPerlinNoiseTexture(
+    RandomEngine & rng,
+    const RenderTarget & target,
+    const bool & random_colors,
+    const double & z1,
+    const double & z2,
+    const double & z3,
+    const double & frequency)
+{
+    TextureSpec spec(TextureSpec::PERLIN, target.getSize());
+    spec.random_colors = random_colors;
+    spec.z1 = z1;
+    spec.z2 = z2;
+    spec.z3 = z3;
+    spec.frequency = frequency;
+    resolveTexture(spec, rng).render(target);
+}
 
-                // Red
-                val[0] = 20.0 * pn.noise(x, y, z1);
-                val[0] = val[0] - floor(val[0]);
-                val[0] = floor(255 * val[0]);
-                // Green
-                val[1] = 20.0 * pn.noise(x, y, z2);
-                val[1] = val[1] - floor(val[1]);
-                val[1] = floor(255 * val[1]);
-                // Blue
-                val[2] = 20.0 * pn.noise(x, y, z3);
-                val[2] = val[2] - floor(val[2]);
-                val[2] = floor(255 * val[2]);
+void PatternGeneration::getPerlinNoiseTexture(
+    RandomEngine & rng,
+    uint8_t * data,
+    int width,
+    int height,
+    size_t stride,
+    const bool & random_colors,
+    const double & z1,
+    const double & z2,
+    const double & z3,
+    const double & frequency)
+{
+    cv::Mat texture = wrapBuffer(data, width, height, stride);
+    getPerlinNoiseTexture(rng, texture, random_colors, z1, z2, z3, frequency);
+}
 
-            }
-            image.at<cv::Vec3b>(i,j) = val;
+cv::Mat PatternGeneration::getFractalNoiseTexture(
+    const int & imageSize,
+    RandomEngine & rng,
+    const FractalNoise::Type & type,
+    const int & octaves,
+    const double & lacunarity,
+    const double & gain,
+    const double & frequency)
+{
+    cv::Mat image(imageSize,imageSize,CV_8UC3);
+    getFractalNoiseTexture(rng, image, type, octaves, lacunarity, gain, frequency);
+    return image;
+}
+
+void PatternGeneration::getFractalNoiseTexture(
+    RandomEngine & rng,
+    cv::Mat & texture,
+    const FractalNoise::Type & type,
+    const int & octaves,
+    const double & lacunarity,
+    const double & gain,
+    const double & frequency)
+{
+    getFractalNoiseTexture(rng, RenderTarget(texture), type, octaves, lacunarity, gain, frequency);
+}
+
+void PatternGeneration::getFractalNoiseTexture(
+    RandomEngine & rng,
+    const RenderTarget & target,
+    const FractalNoise::Type & type,
+    const int & octaves,
+    const double & lacunarity,
+    const double & gain,
+    const double & frequency)
+{
+    TextureSpec spec(TextureSpec::FRACTAL, target.getSize());
+    spec.type = type;
+    spec.octaves = octaves;
+    spec.lacunarity = lacunarity;
+    spec.gain = gain;
+    spec.frequency = frequency;
+    resolveTexture(spec, rng).render(target);
+}
+
+void PatternGeneration::getFractalNoiseTexture(
+    RandomEngine & rng,
+    uint8_t * data,
+    int width,
+    int height,
+    size_t stride,
+    const FractalNoise::Type & type,
+    const int & octaves,
+    const double & lacunarity,
+    const double & gain,
+    const double & frequency)
+{
+    cv::Mat texture = wrapBuffer(data, width, height, stride);
+    getFractalNoiseTexture(rng, texture, type, octaves, lacunarity, gain, frequency);
+}
+
+ProceduralTexture PatternGeneration::getProceduralTexture(const TextureSpec & spec) const
+{
+    // The spec is shared, its engine is not advanced
+    TextureSpec resolved = spec;
+    if (resolved.frequency <= 0)
+        resolved.frequency = spec.pattern == TextureSpec::FRACTAL ? 4.0 : 1.0;
+    RandomEngine rng = spec.rng;
+    return resolveTexture(resolved, rng);
+}
+
+ProceduralTexture PatternGeneration::resolveTexture(const TextureSpec & spec,
+    RandomEngine & rng) const
+{
+    // The noise patterns draw from rng in the order the generators always
+    // have: the permutation vector, then the pixel stream or the planes
+    ProceduralTexture texture(spec, precision, color_space, renderer);
+    if (spec.pattern != TextureSpec::PERLIN && spec.pattern != TextureSpec::FRACTAL)
+        return texture;
+
+    // Pick a permutation vector from the pool, shared rather than copied,
+    // or shuffle one from rng when there is no pool. Table k only depends
+    // on the seed and k
+    if (!perlin_tables) {
+        texture.noise = std::make_shared<PerlinNoise>(rng);
+    } else {
+        const int k = rng.uniform(perlin_tables->tables.size());
+        PerlinNoise & table = perlin_tables->tables[k];
+        std::call_once(perlin_tables->shuffled[k], [&]{
+            RandomEngine table_rng = getRandomEngine(k, PERLIN_TABLE_STREAM);
+            table.shuffle(table_rng);
+        });
+        texture.noise = std::shared_ptr<const PerlinNoise>(perlin_tables, &table);
+    }
+
+    if (spec.pattern == TextureSpec::PERLIN) {
+        texture.pixel_rng = RandomEngine(rng());
+    } else {
+        for (int c = 0; c < 3; ++c)
+            texture.fractal_z[c] = (float) rng.uniformReal();
+    }
+    return texture;
+}
+
+void PatternGeneration::generateBatch(
+    const std::vector<TextureSpec> & specs,
+    std::vector<cv::Mat> & textures)
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    // A texture with fewer tiles than threads cannot keep them all busy on
+    // its own, it is drawn whole by one thread instead
+    std::vector<size_t> whole, tiled;
+    textures.resize(specs.size());
+    for (size_t k = 0; k < specs.size(); ++k) {
+        textures[k].create(specs[k].size, CV_8UC3);
+        if (renderer.getTileCount(specs[k].size) < threads)
+            whole.push_back(k);
+        else
+            tiled.push_back(k);
+    }
+
+    // Within this region the tile loops run on the calling thread only
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < (int) whole.size(); ++k)
+        getProceduralTexture(specs[whole[k]]).render(RenderTarget(textures[whole[k]]));
+
+    for (size_t k : tiled)
+        getProceduralTexture(specs[k]).render(RenderTarget(textures[k]));
+}
+
+ProceduralTexture::ProceduralTexture(
+    const TextureSpec & spec,
+    PatternGeneration::Precision precision,
+    PatternGeneration::ColorSpace color_space,
+    const TileRenderer & renderer) :
+    spec(spec),
+    precision(precision),
+    color_space(color_space),
+    renderer(renderer)
+{
+    std::fill(fractal_z, fractal_z + 3, 0.0f);
+}
+
+const TextureSpec & ProceduralTexture::getSpec() const
+{
+    return spec;
+}
+
+cv::Size ProceduralTexture::getSize() const
+{
+    return spec.size;
+}
+
+void ProceduralTexture::render(const RenderTarget & target) const
+{
+    render(target, false);
+}
+
+void ProceduralTexture::render(const RenderTarget & target, bool filtered) const
+{
+    const cv::Size size = target.getSize();
+    const cv::Rect region = target.getRegion();
+    // Streamed bands are read by the sink right away, from the cache
+    const bool stream = !target.getSink() && (size_t) region.area() * 3 > STREAM_FILL_BYTES;
+
+    switch (spec.pattern) {
+    case TextureSpec::FLAT: {
+        std::vector<cv::Vec3b> & pattern = rowBuffers().colors;
+        pattern.assign(region.width, convertColor(spec.color1, color_space));
+        renderer.render(FlatKernel(pattern.data(), stream), target);
+        break;
+    }
+    case TextureSpec::CHESS: {
+        CV_Assert(spec.block_size > 0);
+        // Only the two colors are converted, not every pixel. The square
+        // starting at column i of the row of squares starting at row j takes
+        // the color of (i + j) % 2. At another size than the texture's,
+        // pixels take the color of the texture pixel they scale to
+        const cv::Vec3b colors[2] = {
+            convertColor(spec.color1, color_space), convertColor(spec.color2, color_space)
+        };
+        if (filtered) {
+            // The square colors blended by how much of each a pixel covers
+            std::vector<float> (& coverage)[2] = rowBuffers().coverage;
+            coverage[0].resize(region.width);
+            coverage[1].resize(region.height);
+            chessCoverage(coverage[0].data(), region.x, region.width, size.width,
+                spec.size.width, spec.block_size);
+            chessCoverage(coverage[1].data(), region.y, region.height, size.height,
+                spec.size.height, spec.block_size);
+            renderer.render(ChessBlendKernel(colors[0], colors[1], coverage[0].data(),
+                coverage[1].data()), target);
+            break;
+        }
+        std::vector<cv::Vec3b> & patterns = rowBuffers().colors;
+        patterns.resize(2 * region.width);
+        for (int x = 0; x < region.width; ++x) {
+            const int board_x = (int) ((int64_t) (region.x + x) * spec.size.width / size.width);
+            const int i = board_x - board_x % spec.block_size;
+            patterns[x] = colors[i % 2];
+            patterns[region.width + x] = colors[(i + 1) % 2];
         }
+        renderer.render(ChessKernel(patterns.data(), patterns.data() + region.width,
+            spec.block_size, size.height, spec.size.height, stream), target);
+        break;
+    }
+    case TextureSpec::GRADIENT: {
+        const int steps = spec.vertical ? size.height : size.width;
+        const int first = spec.vertical ? region.y : region.x;
+        const int count = spec.vertical ? region.height : region.width;
+
+        cv::Scalar gradient_step(spec.color1-spec.color2);
+
+        // Filtered, the colors are those of the texture rows or columns the
+        // region covers, averaged below
+        const int length = spec.vertical ? spec.size.height : spec.size.width;
+        const int begin = filtered ? boxStart(first, length, steps) : first;
+        const int end = filtered ? boxStart(first + count, length, steps) : first + count;
+        const int color_steps = filtered ? length : steps;
+
+        // One color per row or column of the region, converted once before
+        // filling. The buffer belongs to the calling thread, the tile
+        // kernels only read it
+        std::vector<cv::Vec3b> & colors = rowBuffers().colors;
+        colors.resize(end - begin);
+        for(int k = begin; k < end; k++)
+        {
+            cv::Vec3b & val = colors[k - begin];
+
+            val[0] = spec.color1[0]-k*gradient_step[0]/color_steps;
+            val[1] = spec.color1[1]-k*gradient_step[1]/color_steps;
+            val[2] = spec.color1[2]-k*gradient_step[2]/color_steps;
+        }
+        convertLab(colors.data(), end - begin, color_space);
+
+        // Average in place, every box starts at or after the color it
+        // becomes
+        for (int k = 0; filtered && k < count; k++)
+        {
+            const int box_begin = boxStart(first + k, length, steps) - begin;
+            const int box_end = boxStart(first + k + 1, length, steps) - begin;
+            const int box = box_end - box_begin;
+            int sum[3] = {0, 0, 0};
+            for (int i = box_begin; i < box_end; i++)
+                for (int c = 0; c < 3; c++)
+                    sum[c] += colors[i][c];
+            for (int c = 0; c < 3; c++)
+                colors[k][c] = (uchar) ((sum[c] + box / 2) / box);
+        }
+
+        if (spec.vertical)
+            renderer.render(GradientKernel<true>(colors.data(), first), target);
+        else
+            renderer.render(GradientKernel<false>(colors.data(), first), target);
+        break;
+    }
+    case TextureSpec::PERLIN: {
+        // Visit every pixel of the region and assign a color generated with
+        // Perlin noise, with the kernel specialized for the precision and
+        // color mode
+        const double z[3] = {spec.z1, spec.z2, spec.z3};
+        if (filtered && !spec.random_colors) {
+            // Parts of at most MAX_LINEAR_CELLS lattice cells
+            const int samples = (int) std::ceil(spec.frequency / (size.width * MAX_LINEAR_CELLS));
+            renderer.render(PerlinFilteredKernel(*noise, z, spec.frequency, size.width,
+                std::max(1, samples), color_space), target);
+            break;
+        }
+        PERLIN_RENDERERS[precision][spec.random_colors ? 1 : 0](renderer, *noise, pixel_rng, z,
+            spec.frequency, color_space, target);
+        break;
+    }
+    case TextureSpec::FRACTAL: {
+        // One permutation vector for every octave and channel
+        FractalNoise fn(*noise, spec.type, spec.octaves, (float) spec.lacunarity,
+            (float) spec.gain);
+        // Octave lattice cells at least two pixels wide, x advancing by
+        // frequency / width per pixel
+        if (filtered)
+            fn.setMaxFrequency((float) (size.width / (2.0 * spec.frequency)));
+        renderer.render(FractalKernel(fn, fractal_z, spec.frequency, size.width, color_space),
+            target);
+        break;
+    }
+    }
+}
+
+void ProceduralTexture::render(
+    const cv::Rect & region,
+    cv::Mat & pixels,
+    const cv::Size & size) const
+{
+    pixels.create(region.size(), CV_8UC3);
+    render(RenderTarget(size.area() > 0 ? size : spec.size, pixels, region.tl()));
+}
+
+cv::Mat ProceduralTexture::getRegion(const cv::Rect & region, const cv::Size & size) const
+{
+    cv::Mat pixels;
+    render(region, pixels, size);
+    return pixels;
+}
+
+int ProceduralTexture::getMipLevels() const
+{
+    int levels = 1;
+    for (int side = std::max(spec.size.width, spec.size.height); side > 1; side /= 2)
+        ++levels;
+    return levels;
+}
+
+cv::Size ProceduralTexture::getMipSize(int level) const
+{
+    return cv::Size(std::max(1, spec.size.width >> level), std::max(1, spec.size.height >> level));
+}
+
+void ProceduralTexture::renderMipmaps(std::vector<cv::Mat> & levels, int first) const
+{
+    const int count = getMipLevels();
+    levels.resize(count);
+
+    for (int level = std::max(0, first); level < count; ++level) {
+        cv::Mat & pixels = levels[level];
+        pixels.create(getMipSize(level), CV_8UC3);
+        if (level > 0 && spec.pattern == TextureSpec::PERLIN && spec.random_colors)
+            cv::resize(levels[level - 1], pixels, pixels.size(), 0, 0, cv::INTER_AREA);
+        else
+            render(RenderTarget(pixels), level > 0);
     }
-    cvtColor(image,image,cv::COLOR_Lab2RGB); // converting back to 8U with scaling
-    return image;
 }
@@ -1,6 +1,5 @@
 #include "pattern_generation/PerlinNoise.h"
 #include <cmath>
-#include <random>
 #include <algorithm>
 #include <numeric>
 
@@ -9,38 +8,54 @@
 // THE ORIGINAL JAVA IMPLEMENTATION IS COPYRIGHT 2002 KEN PERLIN
 
 // Generate a new permutation vector based on the value of seed
-PerlinNoise::PerlinNoise() {
-    p.resize(256);
+PerlinNoise::PerlinNoise(uint64_t seed) {
+    RandomEngine engine(seed);
+    shuffle(engine);
+}
 
-    // Fill p with values from 0 to 255
-    std::iota(p.begin(), p.end(), 0);
+// Generate a new permutation vector drawn from engine
+PerlinNoise::PerlinNoise(RandomEngine & engine) {
+    shuffle(engine);
+}
 
-    // Initialize a random engine
-    std::random_device rd;
-    std::mt19937 engine(rd());
+void PerlinNoise::shuffle(RandomEngine & engine) {
+    // Fill p with values from 0 to 255
+    std::iota(p.begin(), p.begin() + 256, 0);
 
-    // Suffle  using the above random engine
-    std::shuffle(p.begin(), p.end(), engine);
+    // Fisher-Yates shuffle. Unlike std::shuffle the result does not depend
+    // on the standard library, so a seed gives the same table everywhere
+    for (int i = 255; i > 0; --i)
+        std::swap(p[i], p[engine.uniform(i + 1)]);
 
     // Duplicate the permutation vector
-    p.insert(p.end(), p.begin(), p.end());
+    std::copy(p.begin(), p.begin() + 256, p.begin() + 256);
+    std::fill(p.begin() + 512, p.end(), 0);
+}
+
+double PerlinNoise::noise(double x, double y, double z) const {
+    return evaluate(x, y, z);
+}
+
+float PerlinNoise::noisef(float x, float y, float z) const {
+    return evaluate(x, y, z);
 }
 
-double PerlinNoise::noise(double x, double y, double z) {
+template <typename T>
+T PerlinNoise::evaluate(T x, T y, T z) const {
     // Find the unit cube that contains the point
-    int X = (int) floor(x) & 255;
-    int Y = (int) floor(y) & 255;
-    int Z = (int) floor(z) & 255;
+    int X = (int) std::floor(x) & 255;
+    int Y = (int) std::floor(y) & 255;
+    int Z = (int) std::floor(z) & 255;
 
     // Find relative x, y,z of point in cube
-    x -= floor(x);
-    y -= floor(y);
-    z -= floor(z);
+    x -= std::floor(x);
+    y -= std::floor(y);
+    z -= std::floor(z);
 
     // Compute fade curves for each of x, y, z
-    double u = fade(x);
-    double v = fade(y);
-    double w = fade(z);
+    T u = fade(x);
+    T v = fade(y);
+    T w = fade(z);
 
     // Hash coordinates of the 8 cube corners
     int A = p[X] + Y;
@@ -51,7 +66,7 @@ double PerlinNoise::noise(double x, double y, double z) {
     int BB = p[B + 1] + Z;
 
     // Add blended results from 8 corners of cube
-    double res = 
+    T res = 
         lerp(w,
             lerp(v,
                 lerp(u,
@@ -67,22 +82,254 @@ double PerlinNoise::noise(double x, double y, double z) {
                 lerp(u, grad(p[AB+1], x, y-1, z-1),
                     grad(p[BB+1], x-1, y-1, z-1))));
 
-    return (res + 1.0) / 2.0;
+    return (res + 1) / 2;
+}
+
+void PerlinNoise::noise(double x, double y, const double * z, double * out, int planes) const {
+    evaluatePlanes(x, y, z, out, planes);
+}
+
+void PerlinNoise::noisef(float x, float y, const float * z, float * out, int planes) const {
+    evaluatePlanes(x, y, z, out, planes);
+}
+
+template <typename T>
+void PerlinNoise::evaluatePlanes(T x, T y, const T * z, T * out, int planes) const {
+    // The unit square, relative position, fade curves and hashes of x and y
+    // are shared by all the planes
+    int X = (int) std::floor(x) & 255;
+    int Y = (int) std::floor(y) & 255;
+    x -= std::floor(x);
+    y -= std::floor(y);
+    T u = fade(x);
+    T v = fade(y);
+    int A = p[X] + Y;
+    int B = p[X + 1] + Y;
+    int PA = p[A], PA1 = p[A + 1], PB = p[B], PB1 = p[B + 1];
+
+    for (int c = 0; c < planes; ++c) {
+        T zc = z[c];
+        int Z = (int) std::floor(zc) & 255;
+        zc -= std::floor(zc);
+        T w = fade(zc);
+
+        int AA = PA + Z;
+        int AB = PA1 + Z;
+        int BA = PB + Z;
+        int BB = PB1 + Z;
+
+        T res =
+            lerp(w,
+                lerp(v,
+                    lerp(u,
+                        grad(p[AA], x, y, zc),
+                        grad(p[BA], x-1, y, zc)),
+                    lerp(u,
+                        grad(p[AB], x, y-1, zc),
+                        grad(p[BB], x-1, y-1, zc))),
+                lerp(v,
+                    lerp(u,
+                        grad(p[AA+1],x, y, zc-1),
+                        grad(p[BA+1], x-1, y, zc-1)),
+                    lerp(u, grad(p[AB+1], x, y-1, zc-1),
+                        grad(p[BB+1], x-1, y-1, zc-1))));
+
+        out[c] = (res + 1) / 2;
+    }
+}
+
+void PerlinNoise::noiseRow(const double * x, double y, double z, double * out, size_t n) const {
+    evaluateRow(x, y, (const double *) NULL, z, out, n);
+}
+
+void PerlinNoise::noiseRow(const double * x, double y, const double * z, double * out, size_t n) const {
+    evaluateRow(x, y, z, 0.0, out, n);
+}
+
+void PerlinNoise::noiseRow(const float * x, float y, float z, float * out, size_t n) const {
+    evaluateRow(x, y, (const float *) NULL, z, out, n);
+}
+
+void PerlinNoise::noiseRow(const float * x, float y, const float * z, float * out, size_t n) const {
+    evaluateRow(x, y, z, 0.0f, out, n);
+}
+
+// Gradient of grad(hash, x, y, z) as a vector, so that the gradient term of a
+// corner becomes a dot product with the offset of the point from the corner
+template <typename T>
+static inline void gradVector(int hash, T g[3]) {
+    int h = hash & 15;
+    T su = (h & 1) == 0 ? 1 : -1;
+    T sv = (h & 2) == 0 ? 1 : -1;
+    g[0] = g[1] = g[2] = 0;
+    g[h < 8 ? 0 : 1] += su;
+    g[h < 4 ? 1 : h == 12 || h == 14 ? 0 : 2] += sv;
+}
+
+template <typename T>
+void PerlinNoise::evaluateRow(const T * x, T y, const T * z, T zs, T * out, size_t n) const {
+    // y, and z when it is constant, are the same for the whole row
+    int Y = (int) std::floor(y) & 255;
+    T yr = y - std::floor(y);
+    T v = fade(yr);
+    T zf = std::floor(zs);
+
+    size_t k = 0;
+    while (k < n) {
+        // The lattice cell of the next point, the span of points in it is
+        // found with comparisons rather than a floor per point
+        T xf = std::floor(x[k]);
+        if (z)
+            zf = std::floor(z[k]);
+        size_t end = k + 1;
+        while (end < n && x[end] >= xf && x[end] < xf + 1 &&
+            (!z || (z[end] >= zf && z[end] < zf + 1)))
+            ++end;
+
+        int X = (int) xf & 255;
+        int Z = (int) zf & 255;
+        int A = p[X] + Y;
+        int B = p[X + 1] + Y;
+        const int hash[2][2][2] = {
+            {{p[p[A] + Z], p[p[A] + Z + 1]}, {p[p[A + 1] + Z], p[p[A + 1] + Z + 1]}},
+            {{p[p[B] + Z], p[p[B] + Z + 1]}, {p[p[B + 1] + Z], p[p[B + 1] + Z + 1]}}};
+
+        // Every corner term is linear in the relative x and z. Blending the
+        // corners along y leaves 4 linear functions cx * x + cz * z + c0 of the
+        // corners at x offset i and z offset l
+        T c[2][2][3];
+        for (int i = 0; i < 2; ++i) {
+            for (int l = 0; l < 2; ++l) {
+                T g[2][3];
+                T e[2];
+                for (int j = 0; j < 2; ++j) {
+                    gradVector(hash[i][j][l], g[j]);
+                    e[j] = g[j][1] * (yr - j) - g[j][0] * i - g[j][2] * l;
+                }
+                c[i][l][0] = lerp(v, g[0][0], g[1][0]);
+                c[i][l][1] = lerp(v, g[0][2], g[1][2]);
+                c[i][l][2] = lerp(v, e[0], e[1]);
+            }
+        }
+
+        if (z) {
+            for (; k < end; ++k) {
+                T xr = x[k] - xf, zr = z[k] - zf;
+                T u = fade(xr), w = fade(zr);
+                T c00 = c[0][0][0] * xr + c[0][0][1] * zr + c[0][0][2];
+                T c10 = c[1][0][0] * xr + c[1][0][1] * zr + c[1][0][2];
+                T c01 = c[0][1][0] * xr + c[0][1][1] * zr + c[0][1][2];
+                T c11 = c[1][1][0] * xr + c[1][1][1] * zr + c[1][1][2];
+                T res = lerp(w, lerp(u, c00, c10), lerp(u, c01, c11));
+                out[k] = (res + 1) / 2;
+            }
+        } else {
+            // Blending along the constant z too leaves 2 functions of x alone
+            T zr = zs - zf, w = fade(zr);
+            T a0 = lerp(w, c[0][0][0], c[0][1][0]);
+            T a1 = lerp(w, c[1][0][0], c[1][1][0]);
+            T b0 = lerp(w, c[0][0][1] * zr + c[0][0][2], c[0][1][1] * zr + c[0][1][2]);
+            T b1 = lerp(w, c[1][0][1] * zr + c[1][0][2], c[1][1][1] * zr + c[1][1][2]);
+            for (; k < end; ++k) {
+                T xr = x[k] - xf;
+                T res = lerp(fade(xr), a0 * xr + b0, a1 * xr + b1);
+                out[k] = (res + 1) / 2;
+            }
+        }
+    }
 }
 
-double PerlinNoise::fade(double t) { 
+template <typename T>
+T PerlinNoise::fade(T t) { 
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
 
-double PerlinNoise::lerp(double t, double a, double b) { 
+template <typename T>
+T PerlinNoise::lerp(T t, T a, T b) { 
     return a + t * (b - a); 
 }
 
-double PerlinNoise::grad(int hash, double x, double y, double z) {
+template <typename T>
+T PerlinNoise::grad(int hash, T x, T y, T z) {
     int h = hash & 15;
     // Convert lower 4 bits of hash into 12 gradient directions
-    double u = h < 8 ? x : y,
-           v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+    T u = h < 8 ? x : y,
+      v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+    return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+}
+
+// 16.16 fixed point versions of the above. Products are formed in 64 bits
+// and rounded to nearest, every intermediate stays within [-4, 4]
+
+static inline int64_t mulFixed(int64_t a, int64_t b) {
+    return (a * b + (1 << 15)) >> 16;
+}
+
+static inline int32_t fadeFixed(int64_t t) {
+    int64_t t3 = mulFixed(mulFixed(t, t), t);
+    int64_t poly = mulFixed(t, 6 * t - (15 << 16)) + (10 << 16);
+    return (int32_t) mulFixed(t3, poly);
+}
+
+static inline int32_t lerpFixed(int64_t t, int32_t a, int32_t b) {
+    return a + (int32_t) mulFixed(t, b - a);
+}
+
+static inline int32_t gradFixed(int hash, int32_t x, int32_t y, int32_t z) {
+    int h = hash & 15;
+    int32_t u = h < 8 ? x : y,
+            v = h < 4 ? y : h == 12 || h == 14 ? x : z;
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
 
+int32_t PerlinNoise::noiseFixed(int32_t x, int32_t y, int32_t z) const {
+    int32_t res;
+    noiseFixed(x, y, &z, &res, 1);
+    return res;
+}
+
+void PerlinNoise::noiseFixed(int32_t x, int32_t y, const int32_t * z, int32_t * out, int planes) const {
+    const int32_t one = 1 << 16;
+
+    // Integer and fractional parts, the shift floors negative values too
+    int X = (x >> 16) & 255;
+    int Y = (y >> 16) & 255;
+    x &= one - 1;
+    y &= one - 1;
+
+    int32_t u = fadeFixed(x);
+    int32_t v = fadeFixed(y);
+
+    int A = p[X] + Y;
+    int B = p[X + 1] + Y;
+    int PA = p[A], PA1 = p[A + 1], PB = p[B], PB1 = p[B + 1];
+
+    for (int c = 0; c < planes; ++c) {
+        int Z = (z[c] >> 16) & 255;
+        int32_t zc = z[c] & (one - 1);
+        int32_t w = fadeFixed(zc);
+
+        int AA = PA + Z;
+        int AB = PA1 + Z;
+        int BA = PB + Z;
+        int BB = PB1 + Z;
+
+        int32_t res =
+            lerpFixed(w,
+                lerpFixed(v,
+                    lerpFixed(u,
+                        gradFixed(p[AA], x, y, zc),
+                        gradFixed(p[BA], x-one, y, zc)),
+                    lerpFixed(u,
+                        gradFixed(p[AB], x, y-one, zc),
+                        gradFixed(p[BB], x-one, y-one, zc))),
+                lerpFixed(v,
+                    lerpFixed(u,
+                        gradFixed(p[AA+1], x, y, zc-one),
+                        gradFixed(p[BA+1], x-one, y, zc-one)),
+                    lerpFixed(u, gradFixed(p[AB+1], x, y-one, zc-one),
+                        gradFixed(p[BB+1], x-one, y-one, zc-one))));
+
+        out[c] = (res + one) >> 1;
+    }
+}
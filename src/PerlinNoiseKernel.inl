@@ -0,0 +1,169 @@
+// Vectorized improved Perlin noise, written once against a small set of
+// vector primitives and included by PerlinNoiseSimd.cpp once per instruction
+// set. The including file defines, inside a dedicated namespace:
+//   PN_TARGET                     function attribute enabling the ISA
+//   F, I, M, LANES                float vector, int vector, lane mask, width
+//   load, store, set1, set1i, floor, cvt, add, sub, mul,
+//   andi, addi, shl, lt, eq, orm, select, xorsign, gather, zeroupper
+
+PN_TARGET static inline F fade(F t)
+{
+    return mul(mul(mul(t, t), t), add(mul(t, sub(mul(t, set1(6.0f)), set1(15.0f))), set1(10.0f)));
+}
+
+PN_TARGET static inline F lerp(F t, F a, F b)
+{
+    return add(a, mul(t, sub(b, a)));
+}
+
+// Branchless version of PerlinNoise::grad, the 12 gradient directions are
+// picked with lane masks and the signs flipped with the low hash bits
+PN_TARGET static inline F grad(I hash, F x, F y, F z)
+{
+    I h = andi(hash, set1i(15));
+    F u = select(lt(h, 8), x, y);
+    F v = select(lt(h, 4), y, select(orm(eq(h, 12), eq(h, 14)), x, z));
+    return add(xorsign(u, shl(h, 31)), xorsign(v, shl(h, 30)));
+}
+
+// Lattice cell, relative position, fade curves and hashes of LANES (x, y)
+// samples, shared by every plane evaluated at those samples
+struct Lattice
+{
+    F x0, x1, y0, y1, u, v;
+    I PA, PA1, PB, PB1;
+};
+
+PN_TARGET static inline Lattice lattice(const uint8_t * p, const float * x, const float * y)
+{
+    Lattice l;
+    F xv = load(x), yv = load(y);
+    F xf = floor(xv), yf = floor(yv);
+
+    // Find the unit square that contains the point
+    I X = andi(cvt(xf), set1i(255));
+    I Y = andi(cvt(yf), set1i(255));
+
+    // Find relative x, y of point in square
+    l.x0 = sub(xv, xf);
+    l.y0 = sub(yv, yf);
+    l.x1 = sub(l.x0, set1(1.0f));
+    l.y1 = sub(l.y0, set1(1.0f));
+
+    // Compute fade curves for each of x, y
+    l.u = fade(l.x0);
+    l.v = fade(l.y0);
+
+    // Hash coordinates of the 4 square corners
+    I one = set1i(1);
+    I A = addi(gather(p, X), Y);
+    I B = addi(gather(p, addi(X, one)), Y);
+    l.PA = gather(p, A);
+    l.PA1 = gather(p, addi(A, one));
+    l.PB = gather(p, B);
+    l.PB1 = gather(p, addi(B, one));
+    return l;
+}
+
+// Evaluate LANES samples of the lattice l on the plane z
+PN_TARGET static inline void noisePlane(const uint8_t * p, const Lattice & l, F zv, float * out)
+{
+    F zf = floor(zv);
+    I Z = andi(cvt(zf), set1i(255));
+    F z0 = sub(zv, zf);
+    F z1 = sub(z0, set1(1.0f));
+    F w = fade(z0);
+
+    // Hash coordinates of the 8 cube corners
+    I one = set1i(1);
+    I AA = addi(l.PA, Z);
+    I AB = addi(l.PA1, Z);
+    I BA = addi(l.PB, Z);
+    I BB = addi(l.PB1, Z);
+
+    // Add blended results from 8 corners of cube
+    const F & u = l.u, & v = l.v;
+    const F & x0 = l.x0, & x1 = l.x1, & y0 = l.y0, & y1 = l.y1;
+    F res =
+        lerp(w,
+            lerp(v,
+                lerp(u,
+                    grad(gather(p, AA), x0, y0, z0),
+                    grad(gather(p, BA), x1, y0, z0)),
+                lerp(u,
+                    grad(gather(p, AB), x0, y1, z0),
+                    grad(gather(p, BB), x1, y1, z0))),
+            lerp(v,
+                lerp(u,
+                    grad(gather(p, addi(AA, one)), x0, y0, z1),
+                    grad(gather(p, addi(BA, one)), x1, y0, z1)),
+                lerp(u,
+                    grad(gather(p, addi(AB, one)), x0, y1, z1),
+                    grad(gather(p, addi(BB, one)), x1, y1, z1))));
+
+    store(out, mul(add(res, set1(1.0f)), set1(0.5f)));
+}
+
+// Evaluate LANES samples at (x, y, z)
+PN_TARGET static inline void noiseBlock(const uint8_t * p, const float * x, const float * y,
+    F zv, float * out)
+{
+    noisePlane(p, lattice(p, x, y), zv, out);
+}
+
+// Evaluate n samples, on the plane zs when z is null and at z[k] otherwise
+PN_TARGET static void noiseBatch(const uint8_t * p, const float * x, const float * y,
+    const float * z, float zs, float * out, size_t n)
+{
+    size_t k = 0;
+    for (; k + LANES <= n; k += LANES)
+        noiseBlock(p, x + k, y + k, z ? load(z + k) : set1(zs), out + k);
+
+    // Pad the remainder to a full vector
+    if (k < n) {
+        float xt[LANES] = {0}, yt[LANES] = {0}, zt[LANES] = {0}, ot[LANES];
+        for (size_t l = 0; l < n - k; ++l) {
+            xt[l] = x[k + l];
+            yt[l] = y[k + l];
+            zt[l] = z ? z[k + l] : zs;
+        }
+        noiseBlock(p, xt, yt, load(zt), ot);
+        for (size_t l = 0; l < n - k; ++l)
+            out[k + l] = ot[l];
+    }
+
+    // Leaving the upper vector halves dirty slows down any SSE code that
+    // runs next, e.g. libm, until the next AVX instruction
+    zeroupper();
+}
+
+// Evaluate n samples on a number of planes, plane c at z[c][k] into out[c][k]
+PN_TARGET static void noisePlanesBatch(const uint8_t * p, const float * x, const float * y,
+    const float * const * z, float * const * out, int planes, size_t n)
+{
+    size_t k = 0;
+    for (; k + LANES <= n; k += LANES) {
+        Lattice l = lattice(p, x + k, y + k);
+        for (int c = 0; c < planes; ++c)
+            noisePlane(p, l, load(z[c] + k), out[c] + k);
+    }
+
+    // Pad the remainder to a full vector
+    if (k < n) {
+        float xt[LANES] = {0}, yt[LANES] = {0}, zt[LANES] = {0}, ot[LANES];
+        for (size_t l = 0; l < n - k; ++l) {
+            xt[l] = x[k + l];
+            yt[l] = y[k + l];
+        }
+        Lattice l = lattice(p, xt, yt);
+        for (int c = 0; c < planes; ++c) {
+            for (size_t m = 0; m < n - k; ++m)
+                zt[m] = z[c][k + m];
+            noisePlane(p, l, load(zt), ot);
+            for (size_t m = 0; m < n - k; ++m)
+                out[c][k + m] = ot[m];
+        }
+    }
+
+    zeroupper();
+}
@@ -0,0 +1,233 @@
+#include "pattern_generation/PerlinNoise.h"
+#include <cmath>
+#include <cstddef>
+
+// Batch evaluation of the noise function. The kernel in PerlinNoiseKernel.inl
+// is compiled once per instruction set through function target attributes,
+// so the library itself needs no special compiler flags and the best
+// version is picked at runtime.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PERLIN_NOISE_X86
+#include <immintrin.h>
+#endif
+
+#ifdef PERLIN_NOISE_X86
+
+namespace sse4 {
+
+#define PN_TARGET __attribute__((target("sse4.1")))
+
+typedef __m128 F;
+typedef __m128i I;
+typedef __m128 M;
+static const size_t LANES = 4;
+
+PN_TARGET static inline F load(const float * a) { return _mm_loadu_ps(a); }
+PN_TARGET static inline void store(float * a, F v) { _mm_storeu_ps(a, v); }
+PN_TARGET static inline F set1(float a) { return _mm_set1_ps(a); }
+PN_TARGET static inline I set1i(int a) { return _mm_set1_epi32(a); }
+PN_TARGET static inline F floor(F a) { return _mm_floor_ps(a); }
+PN_TARGET static inline I cvt(F a) { return _mm_cvttps_epi32(a); }
+PN_TARGET static inline F add(F a, F b) { return _mm_add_ps(a, b); }
+PN_TARGET static inline F sub(F a, F b) { return _mm_sub_ps(a, b); }
+PN_TARGET static inline F mul(F a, F b) { return _mm_mul_ps(a, b); }
+PN_TARGET static inline I andi(I a, I b) { return _mm_and_si128(a, b); }
+PN_TARGET static inline I addi(I a, I b) { return _mm_add_epi32(a, b); }
+PN_TARGET static inline I shl(I a, int n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+PN_TARGET static inline M lt(I a, int b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, _mm_set1_epi32(b))); }
+PN_TARGET static inline M eq(I a, int b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, _mm_set1_epi32(b))); }
+PN_TARGET static inline M orm(M a, M b) { return _mm_or_ps(a, b); }
+PN_TARGET static inline F select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+PN_TARGET static inline F xorsign(F v, I bits)
+{
+    return _mm_xor_ps(v, _mm_castsi128_ps(_mm_and_si128(bits, _mm_set1_epi32(0x80000000))));
+}
+// No hardware gather before AVX2
+PN_TARGET static inline I gather(const uint8_t * p, I idx)
+{
+    return _mm_setr_epi32(p[_mm_extract_epi32(idx, 0)], p[_mm_extract_epi32(idx, 1)],
+        p[_mm_extract_epi32(idx, 2)], p[_mm_extract_epi32(idx, 3)]);
+}
+PN_TARGET static inline void zeroupper() {}
+
+#include "PerlinNoiseKernel.inl"
+#undef PN_TARGET
+
+}
+
+namespace avx2 {
+
+#define PN_TARGET __attribute__((target("avx2,fma")))
+
+typedef __m256 F;
+typedef __m256i I;
+typedef __m256 M;
+static const size_t LANES = 8;
+
+PN_TARGET static inline F load(const float * a) { return _mm256_loadu_ps(a); }
+PN_TARGET static inline void store(float * a, F v) { _mm256_storeu_ps(a, v); }
+PN_TARGET static inline F set1(float a) { return _mm256_set1_ps(a); }
+PN_TARGET static inline I set1i(int a) { return _mm256_set1_epi32(a); }
+PN_TARGET static inline F floor(F a) { return _mm256_floor_ps(a); }
+PN_TARGET static inline I cvt(F a) { return _mm256_cvttps_epi32(a); }
+PN_TARGET static inline F add(F a, F b) { return _mm256_add_ps(a, b); }
+PN_TARGET static inline F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+PN_TARGET static inline F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+PN_TARGET static inline I andi(I a, I b) { return _mm256_and_si256(a, b); }
+PN_TARGET static inline I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+PN_TARGET static inline I shl(I a, int n) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+PN_TARGET static inline M lt(I a, int b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(b), a)); }
+PN_TARGET static inline M eq(I a, int b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, _mm256_set1_epi32(b))); }
+PN_TARGET static inline M orm(M a, M b) { return _mm256_or_ps(a, b); }
+PN_TARGET static inline F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+PN_TARGET static inline F xorsign(F v, I bits)
+{
+    return _mm256_xor_ps(v, _mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x80000000))));
+}
+// The table holds bytes, every lane loads 4 and keeps the lowest
+PN_TARGET static inline I gather(const uint8_t * p, I idx)
+{
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int *) p, idx, 1), _mm256_set1_epi32(255));
+}
+PN_TARGET static inline void zeroupper() { _mm256_zeroupper(); }
+
+#include "PerlinNoiseKernel.inl"
+#undef PN_TARGET
+
+}
+
+// GCC 12 flags the undefined source operands inside the AVX-512 intrinsics
+// headers as uninitialized (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace avx512 {
+
+#define PN_TARGET __attribute__((target("avx512f")))
+
+typedef __m512 F;
+typedef __m512i I;
+typedef __mmask16 M;
+static const size_t LANES = 16;
+
+PN_TARGET static inline F load(const float * a) { return _mm512_loadu_ps(a); }
+PN_TARGET static inline void store(float * a, F v) { _mm512_storeu_ps(a, v); }
+PN_TARGET static inline F set1(float a) { return _mm512_set1_ps(a); }
+PN_TARGET static inline I set1i(int a) { return _mm512_set1_epi32(a); }
+PN_TARGET static inline F floor(F a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+PN_TARGET static inline I cvt(F a) { return _mm512_cvttps_epi32(a); }
+PN_TARGET static inline F add(F a, F b) { return _mm512_add_ps(a, b); }
+PN_TARGET static inline F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+PN_TARGET static inline F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+PN_TARGET static inline I andi(I a, I b) { return _mm512_and_si512(a, b); }
+PN_TARGET static inline I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+PN_TARGET static inline I shl(I a, int n) { return _mm512_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+PN_TARGET static inline M lt(I a, int b) { return _mm512_cmplt_epi32_mask(a, _mm512_set1_epi32(b)); }
+PN_TARGET static inline M eq(I a, int b) { return _mm512_cmpeq_epi32_mask(a, _mm512_set1_epi32(b)); }
+PN_TARGET static inline M orm(M a, M b) { return (M) (a | b); }
+PN_TARGET static inline F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+PN_TARGET static inline F xorsign(F v, I bits)
+{
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v),
+        _mm512_and_si512(bits, _mm512_set1_epi32(0x80000000))));
+}
+PN_TARGET static inline I gather(const uint8_t * p, I idx)
+{
+    return _mm512_and_si512(_mm512_i32gather_epi32(idx, p, 1), _mm512_set1_epi32(255));
+}
+PN_TARGET static inline void zeroupper() { _mm256_zeroupper(); }
+
+#include "PerlinNoiseKernel.inl"
+#undef PN_TARGET
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+static PerlinNoise::SimdLevel detectSimdLevel() {
+#ifdef PERLIN_NOISE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return PerlinNoise::SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return PerlinNoise::SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return PerlinNoise::SIMD_SSE4;
+#endif
+    return PerlinNoise::SIMD_SCALAR;
+}
+
+PerlinNoise::SimdLevel PerlinNoise::simdLevel() {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+void PerlinNoise::noise8(const float * x, const float * y, float z, float * out) const {
+    noise(x, y, z, out, 8);
+}
+
+void PerlinNoise::noise(const float * x, const float * y, float z, float * out, size_t n,
+    SimdLevel level) const {
+    noiseBatch(x, y, NULL, z, out, n, level);
+}
+
+void PerlinNoise::noise(const float * x, const float * y, const float * z, float * out, size_t n,
+    SimdLevel level) const {
+    noiseBatch(x, y, z, 0.0f, out, n, level);
+}
+
+void PerlinNoise::noise(const float * x, const float * y, const float * const * z,
+    float * const * out, int planes, size_t n, SimdLevel level) const {
+    if (level > simdLevel())
+        level = simdLevel();
+
+    switch (level) {
+#ifdef PERLIN_NOISE_X86
+        case SIMD_AVX512:
+            avx512::noisePlanesBatch(p.data(), x, y, z, out, planes, n);
+            return;
+        case SIMD_AVX2:
+            avx2::noisePlanesBatch(p.data(), x, y, z, out, planes, n);
+            return;
+        case SIMD_SSE4:
+            sse4::noisePlanesBatch(p.data(), x, y, z, out, planes, n);
+            return;
+#endif
+        default:
+            for (size_t k = 0; k < n; ++k)
+                for (int c = 0; c < planes; ++c)
+                    out[c][k] = noisef(x[k], y[k], z[c][k]);
+    }
+}
+
+void PerlinNoise::noiseBatch(const float * x, const float * y, const float * z, float zs,
+    float * out, size_t n, SimdLevel level) const {
+    // Never run code the CPU cannot execute
+    if (level > simdLevel())
+        level = simdLevel();
+
+    switch (level) {
+#ifdef PERLIN_NOISE_X86
+        case SIMD_AVX512:
+            avx512::noiseBatch(p.data(), x, y, z, zs, out, n);
+            return;
+        case SIMD_AVX2:
+            avx2::noiseBatch(p.data(), x, y, z, zs, out, n);
+            return;
+        case SIMD_SSE4:
+            sse4::noiseBatch(p.data(), x, y, z, zs, out, n);
+            return;
+#endif
+        default:
+            for (size_t k = 0; k < n; ++k)
+                out[k] = noisef(x[k], y[k], z ? z[k] : zs);
+    }
+}
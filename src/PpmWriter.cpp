@@ -0,0 +1,37 @@
+#include "pattern_generation/PpmWriter.h"
+
+PpmWriter::PpmWriter(const std::string & path) :
+    path(path)
+{
+}
+
+void PpmWriter::begin(const cv::Size & size)
+{
+    file.open(path, std::ios::binary);
+    file << "P6\n" << size.width << " " << size.height << "\n255\n";
+    row.resize((size_t) size.width * 3);
+}
+
+void PpmWriter::writeBand(const cv::Mat & band, int band_y)
+{
+    CV_Assert(band.type() == CV_8UC3 && (size_t) band.cols * 3 == row.size());
+    for (int y = 0; y < band.rows && file; ++y) {
+        const uchar * bgr = band.ptr<uchar>(y);
+        for (size_t k = 0; k < row.size(); k += 3) {
+            row[k] = bgr[k + 2];
+            row[k + 1] = bgr[k + 1];
+            row[k + 2] = bgr[k];
+        }
+        file.write(reinterpret_cast<const char *>(row.data()), row.size());
+    }
+}
+
+void PpmWriter::end()
+{
+    file.close();
+}
+
+bool PpmWriter::good() const
+{
+    return !file.fail();
+}
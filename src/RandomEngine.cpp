@@ -0,0 +1,17 @@
+#include "pattern_generation/RandomEngine.h"
+
+const uint64_t RandomEngine::GOLDEN_GAMMA;
+
+RandomEngine::RandomEngine(uint64_t seed) :
+    state(mix(seed))
+{
+}
+
+RandomEngine::RandomEngine(uint64_t seed, uint64_t index, uint64_t stream)
+{
+    // Hash each coordinate in turn, so that neighbouring indices or streams
+    // start far apart in the sequence instead of overlapping
+    state = mix(seed + GOLDEN_GAMMA);
+    state = mix(state ^ (index + GOLDEN_GAMMA));
+    state = mix(state ^ (stream + GOLDEN_GAMMA));
+}
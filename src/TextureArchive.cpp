@@ -0,0 +1,151 @@
+#include "pattern_generation/TextureArchive.h"
+#include <boost/filesystem.hpp>
+#include <cstring>
+
+namespace {
+
+template <typename T>
+void writeValue(std::ofstream & file, const T & value)
+{
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Reads a value at offset, advancing it, if it lies within size bytes
+template <typename T>
+bool readValue(const char * data, std::size_t size, std::size_t & offset, T & value)
+{
+    if (size - offset < sizeof(value))
+        return false;
+    std::memcpy(&value, data + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+bool readString(const char * data, std::size_t size, std::size_t & offset,
+    uint32_t length, std::string & value)
+{
+    if (size - offset < length)
+        return false;
+    value.assign(data + offset, length);
+    offset += length;
+    return true;
+}
+
+}
+
+TextureArchiveWriter::TextureArchiveWriter(const std::string & path)
+{
+    namespace fs = boost::filesystem;
+    boost::system::error_code error;
+    const uint64_t size = fs::file_size(path, error);
+    if (error || size == 0) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        file.write(TextureArchive::MAGIC, sizeof(TextureArchive::MAGIC));
+        return;
+    }
+
+    // Appending resumes after the last complete record, anything else is
+    // not an archive and is left alone
+    uint64_t end = sizeof(TextureArchive::MAGIC);
+    {
+        TextureArchiveReader archive;
+        if (!archive.open(path))
+            return;
+        const std::vector<TextureArchive::Entry> & entries = archive.getEntries();
+        if (!entries.empty())
+            end = entries.back().offset + entries.back().size;
+    }
+    if (end < size)
+        fs::resize_file(path, end, error);
+    if (!error)
+        file.open(path, std::ios::binary | std::ios::app);
+}
+
+TextureArchiveWriter::~TextureArchiveWriter()
+{
+    close();
+}
+
+bool TextureArchiveWriter::add(const std::string & name, const std::string & params,
+    const void * data, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open())
+        return false;
+    file.write(TextureArchive::RECORD, sizeof(TextureArchive::RECORD));
+    writeValue(file, (uint32_t) name.size());
+    writeValue(file, (uint32_t) params.size());
+    writeValue(file, (uint64_t) size);
+    file.write(name.data(), name.size());
+    file.write(params.data(), params.size());
+    file.write(static_cast<const char *>(data), size);
+    return file.good();
+}
+
+bool TextureArchiveWriter::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open())
+        return false;
+    file.close();
+    return !file.fail();
+}
+
+bool TextureArchiveReader::open(const std::string & path)
+{
+    namespace bip = boost::interprocess;
+    entries.clear();
+    names.clear();
+    try {
+        bip::file_mapping file(path.c_str(), bip::read_only);
+        bip::mapped_region whole(file, bip::read_only);
+        mapping.swap(file);
+        region.swap(whole);
+    } catch (const bip::interprocess_exception &) {
+        return false;
+    }
+
+    const char * data = static_cast<const char *>(region.get_address());
+    const std::size_t size = region.get_size();
+    const std::size_t magic = sizeof(TextureArchive::MAGIC);
+    if (size < magic || std::memcmp(data, TextureArchive::MAGIC, magic) != 0)
+        return false;
+
+    // Every record is bounds checked, the first one that does not fit ends
+    // the archive
+    std::size_t offset = magic;
+    while (size - offset >= sizeof(TextureArchive::RECORD) &&
+        std::memcmp(data + offset, TextureArchive::RECORD, sizeof(TextureArchive::RECORD)) == 0) {
+        offset += sizeof(TextureArchive::RECORD);
+        TextureArchive::Entry entry;
+        uint32_t name_length, params_length;
+        if (!readValue(data, size, offset, name_length) ||
+            !readValue(data, size, offset, params_length) ||
+            !readValue(data, size, offset, entry.size) ||
+            !readString(data, size, offset, name_length, entry.name) ||
+            !readString(data, size, offset, params_length, entry.params) ||
+            entry.size > size - offset)
+            break;
+        entry.offset = offset;
+        offset += entry.size;
+        names[entry.name] = entries.size();
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+const std::vector<TextureArchive::Entry> & TextureArchiveReader::getEntries() const
+{
+    return entries;
+}
+
+const TextureArchive::Entry * TextureArchiveReader::find(const std::string & name) const
+{
+    std::unordered_map<std::string, std::size_t>::const_iterator it = names.find(name);
+    return it != names.end() ? &entries[it->second] : NULL;
+}
+
+const uint8_t * TextureArchiveReader::getData(const TextureArchive::Entry & entry) const
+{
+    return static_cast<const uint8_t *>(region.get_address()) + entry.offset;
+}
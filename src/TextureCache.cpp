@@ -0,0 +1,246 @@
+#include "pattern_generation/TextureCache.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Signature at the start of every cached file
+const char MAGIC[4] = {'P', 'G', 'T', 'C'};
+
+// Parses the hash out of a cached file name, e.g. "0123456789abcdef.tex"
+bool parseHash(const fs::path & file, uint64_t & hash)
+{
+    const std::string stem = file.stem().string();
+    if (file.extension() != TextureCache::EXTENSION || stem.size() != 16 ||
+        stem.find_first_not_of("0123456789abcdef") != std::string::npos)
+        return false;
+    hash = std::stoull(stem, NULL, 16);
+    return true;
+}
+
+// Age after which a temporary file of a live process is taken as left
+// behind, for pids reused since the process that wrote it died
+const std::time_t STALE_TEMPORARY_AGE = 60 * 60;
+
+// Sequence of the temporary files of this process
+std::atomic<uint64_t> temporaries(0);
+
+// Whether a file is a temporary one of put(), e.g.
+// "0123456789abcdef.tex.4711-3.tmp", and gets the pid of its writer
+bool isTemporary(const fs::path & file, pid_t & pid)
+{
+    uint64_t hash;
+    if (file.extension() != ".tmp" || !parseHash(file.stem().stem(), hash))
+        return false;
+    pid = std::atoi(file.stem().extension().string().c_str() + 1);
+    return true;
+}
+
+// Whether a temporary file was left behind by a crashed writer. Other
+// processes sharing the directory may still be writing theirs
+bool isStale(const fs::path & file, pid_t pid)
+{
+    if (pid <= 0 || (kill(pid, 0) != 0 && errno == ESRCH))
+        return true;
+    boost::system::error_code error;
+    const std::time_t time = fs::last_write_time(file, error);
+    return !error && std::time(NULL) - time > STALE_TEMPORARY_AGE;
+}
+
+// Modification time in nanoseconds, the recency of a file between runs.
+// Seconds would leave every file written or read within one tied
+uint64_t modificationTime(const fs::path & file)
+{
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0)
+        return 0;
+    return (uint64_t) status.st_mtim.tv_sec * 1000000000ULL + status.st_mtim.tv_nsec;
+}
+
+}
+
+const char * const TextureCache::EXTENSION = ".tex";
+
+TextureCache::TextureCache(const std::string & directory, uint64_t max_size) :
+    directory(directory), max_size(max_size), size(0), hits(0), misses(0), evictions(0)
+{
+    fs::create_directories(this->directory);
+
+    // Least recently used first, as left by previous runs. Temporary files
+    // left by a run that crashed in put() are removed, those still being
+    // written by other processes are not
+    std::vector<std::pair<uint64_t, Item> > files;
+    for (fs::directory_iterator it(this->directory), end; it != end; ++it) {
+        Item item;
+        pid_t pid;
+        if (!fs::is_regular_file(it->status()))
+            continue;
+        if (isTemporary(it->path(), pid)) {
+            boost::system::error_code error;
+            if (isStale(it->path(), pid))
+                fs::remove(it->path(), error);
+            continue;
+        }
+        if (!parseHash(it->path(), item.hash))
+            continue;
+        item.size = fs::file_size(it->path());
+        files.push_back(std::make_pair(modificationTime(it->path()), item));
+    }
+    std::sort(files.begin(), files.end(),
+        [](const std::pair<uint64_t, Item> & a, const std::pair<uint64_t, Item> & b) {
+            return a.first < b.first;
+        });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const std::pair<uint64_t, Item> & file : files) {
+        lru.push_front(file.second);
+        items[file.second.hash] = lru.begin();
+        size += file.second.size;
+    }
+    evict();
+}
+
+uint64_t TextureCache::hash(const std::string & params)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : params) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+fs::path TextureCache::getPath(uint64_t hash) const
+{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+    return directory / (std::string(name) + EXTENSION);
+}
+
+void TextureCache::evict()
+{
+    while (size > max_size && !lru.empty()) {
+        const Item & item = lru.back();
+        boost::system::error_code error;
+        fs::remove(getPath(item.hash), error);
+        size -= item.size;
+        items.erase(item.hash);
+        lru.pop_back();
+        ++evictions;
+    }
+}
+
+bool TextureCache::get(const std::string & params, std::vector<uint8_t> & data)
+{
+    const uint64_t key = hash(params);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.find(key) == items.end()) {
+            ++misses;
+            return false;
+        }
+    }
+
+    // Read without the lock; a file evicted meanwhile is a miss
+    const fs::path path = getPath(key);
+    std::ifstream file(path.string(), std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    uint32_t length = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char *>(&length), sizeof(length));
+    std::string stored(length, '\0');
+    if (file)
+        file.read(&stored[0], length);
+    if (!file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || stored != params) {
+        ++misses;
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, std::list<Item>::iterator>::iterator it = items.find(key);
+    if (it != items.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        // Now, to the nanosecond where the file system allows
+        utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+    }
+    ++hits;
+    return true;
+}
+
+bool TextureCache::put(const std::string & params, const void * data, std::size_t length)
+{
+    const uint64_t key = hash(params);
+    const uint64_t file_size = sizeof(MAGIC) + sizeof(uint32_t) + params.size() + length;
+    if (file_size > max_size)
+        return false;
+
+    // Written under a name unique to the process and call, then renamed
+    // into place, so that readers never see a partial file
+    const fs::path path = getPath(key);
+    std::stringstream temporary;
+    temporary << path.string() << "." << getpid() << "-" << temporaries++ << ".tmp";
+    {
+        std::ofstream file(temporary.str(), std::ios::binary | std::ios::trunc);
+        const uint32_t params_length = params.size();
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char *>(&params_length), sizeof(params_length));
+        file.write(params.data(), params.size());
+        file.write(static_cast<const char *>(data), length);
+        file.close();
+        if (!file)
+            return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    boost::system::error_code error;
+    fs::rename(temporary.str(), path, error);
+    if (error)
+        return false;
+
+    std::unordered_map<uint64_t, std::list<Item>::iterator>::iterator it = items.find(key);
+    if (it != items.end()) {
+        size -= it->second->size;
+        lru.erase(it->second);
+    }
+    Item item = {key, file_size};
+    lru.push_front(item);
+    items[key] = lru.begin();
+    size += file_size;
+    evict();
+    return true;
+}
+
+uint64_t TextureCache::getHits() const
+{
+    return hits;
+}
+
+uint64_t TextureCache::getMisses() const
+{
+    return misses;
+}
+
+uint64_t TextureCache::getEvictions() const
+{
+    return evictions;
+}
+
+uint64_t TextureCache::getSize()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return size;
+}
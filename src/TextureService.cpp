@@ -0,0 +1,451 @@
+#include "pattern_generation/TextureService.h"
+#include "pattern_generation/Instrumentation.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Slots start on page boundaries, so that rows can be read with any
+// alignment the client needs
+static const std::size_t SLOT_ALIGNMENT = 4096;
+
+// Pending connections on the socket
+static const int SOCKET_BACKLOG = 16;
+
+// Wait before accepting again when out of descriptors or memory, until
+// clients that leave free some
+static const std::chrono::milliseconds ACCEPT_BACKOFF(100);
+
+// Largest octave count, and largest number of lattice cells across a
+// texture for any octave, of the requests served. Beyond them a single
+// request would hold the render thread for good, or overflow the lattice
+static const uint32_t MAX_REQUEST_OCTAVES = 16;
+static const double MAX_REQUEST_FREQUENCY = 1 << 20;
+
+// Whole message transfers, retried on signals and partial writes. Sending
+// to a client that disconnected fails instead of raising SIGPIPE
+static bool readAll(int socket, void * data, std::size_t size)
+{
+    char * bytes = static_cast<char *>(data);
+    while (size > 0) {
+        const ssize_t count = ::recv(socket, bytes, size, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+static bool writeAll(int socket, const void * data, std::size_t size)
+{
+    const char * bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        const ssize_t count = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Parameters a texture can be drawn with in bounded time. Frequency 0 is
+// the pattern default
+static bool validRequest(const TextureService::Request & request)
+{
+    if (request.type != TextureService::TEXTURE || request.pattern > TextureSpec::FRACTAL ||
+        request.fractal_type > FractalNoise::RIDGED || request.width == 0 ||
+        request.height == 0 || (request.pattern == TextureSpec::CHESS && request.block_size == 0))
+        return false;
+    for (int c = 0; c < 3; ++c)
+        if (!std::isfinite(request.color1[c]) || !std::isfinite(request.color2[c]) ||
+            !std::isfinite(request.z[c]))
+            return false;
+    if (!std::isfinite(request.frequency) || request.frequency < 0 ||
+        request.frequency > MAX_REQUEST_FREQUENCY)
+        return false;
+    if (request.pattern != TextureSpec::FRACTAL)
+        return true;
+    if (request.octaves == 0 || request.octaves > MAX_REQUEST_OCTAVES ||
+        !std::isfinite(request.lacunarity) || request.lacunarity <= 0 ||
+        !std::isfinite(request.gain) || request.gain <= 0)
+        return false;
+    // That of the highest octave, from the fractal default of 4 cells
+    const double frequency = (request.frequency > 0 ? request.frequency : 4.0) *
+        std::pow(std::max(request.lacunarity, 1.0), request.octaves - 1.0);
+    return frequency <= MAX_REQUEST_FREQUENCY;
+}
+
+static bool socketAddress(const std::string & path, sockaddr_un & address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    std::strcpy(address.sun_path, path.c_str());
+    return true;
+}
+
+namespace TextureService
+{
+    Request makeRequest(const TextureSpec & spec, uint64_t index, uint64_t stream)
+    {
+        Request request;
+        std::memset(&request, 0, sizeof(request));
+        request.type = TEXTURE;
+        request.pattern = spec.pattern;
+        request.width = std::max(0, spec.size.width);
+        request.height = std::max(0, spec.size.height);
+        request.block_size = std::max(0, spec.block_size);
+        request.vertical = spec.vertical;
+        request.random_colors = spec.random_colors;
+        request.fractal_type = spec.type;
+        request.octaves = std::max(0, spec.octaves);
+        for (int c = 0; c < 3; ++c) {
+            request.color1[c] = spec.color1[c];
+            request.color2[c] = spec.color2[c];
+        }
+        request.z[0] = spec.z1;
+        request.z[1] = spec.z2;
+        request.z[2] = spec.z3;
+        request.frequency = spec.frequency;
+        request.lacunarity = spec.lacunarity;
+        request.gain = spec.gain;
+        request.index = index;
+        request.stream = stream;
+        return request;
+    }
+
+    TextureSpec getSpec(const Request & request)
+    {
+        TextureSpec spec((TextureSpec::Pattern) request.pattern,
+            cv::Size(request.width, request.height));
+        spec.block_size = request.block_size;
+        spec.vertical = request.vertical != 0;
+        spec.random_colors = request.random_colors != 0;
+        spec.type = (FractalNoise::Type) request.fractal_type;
+        spec.octaves = request.octaves;
+        spec.color1 = cv::Scalar(request.color1[0], request.color1[1], request.color1[2]);
+        spec.color2 = cv::Scalar(request.color2[0], request.color2[1], request.color2[2]);
+        spec.z1 = request.z[0];
+        spec.z2 = request.z[1];
+        spec.z3 = request.z[2];
+        spec.frequency = request.frequency;
+        spec.lacunarity = request.lacunarity;
+        spec.gain = request.gain;
+        return spec;
+    }
+}
+
+TextureServer::TextureServer(
+    const PatternGeneration & pattern_generation,
+    const std::string & socket_path,
+    const std::string & ring_name,
+    std::size_t slots,
+    std::size_t slot_size,
+    int threads) :
+    pattern_generation(pattern_generation),
+    socket_path(socket_path),
+    ring_name(ring_name),
+    slot_count(std::max<std::size_t>(1, slots)),
+    slot_size((std::max<std::size_t>(1, slot_size) + SLOT_ALIGNMENT - 1) /
+        SLOT_ALIGNMENT * SLOT_ALIGNMENT),
+    threads(threads),
+    listener(-1),
+    stopping(false),
+    owners(slot_count, -1),
+    jobs(slot_count)
+{
+}
+
+TextureServer::~TextureServer()
+{
+    stop();
+    jobs.close();
+    if (renderer.joinable())
+        renderer.join();
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socket_path.c_str());
+    }
+    if (region.get_address())
+        boost::interprocess::shared_memory_object::remove(ring_name.c_str());
+}
+
+bool TextureServer::start()
+{
+    namespace bip = boost::interprocess;
+    if (ring_name.size() >= sizeof(TextureService::Hello().ring))
+        return false;
+
+    // A server that did not shut down cleanly leaves both behind
+    bip::shared_memory_object::remove(ring_name.c_str());
+    try {
+        bip::shared_memory_object shared(bip::create_only, ring_name.c_str(), bip::read_write);
+        shared.truncate((bip::offset_t) (slot_count * slot_size));
+        bip::mapped_region whole(shared, bip::read_write);
+        memory.swap(shared);
+        region.swap(whole);
+    } catch (const bip::interprocess_exception &) {
+        return false;
+    }
+
+    sockaddr_un address;
+    if (!socketAddress(socket_path, address))
+        return false;
+    ::unlink(socket_path.c_str());
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOCKET_BACKLOG) != 0) {
+        ::close(listener);
+        listener = -1;
+        return false;
+    }
+
+    renderer = std::thread(&TextureServer::render, this);
+    return true;
+}
+
+void TextureServer::run()
+{
+    while (!stopping) {
+        const int connection = ::accept(listener, NULL, NULL);
+        if (connection < 0 && (errno == EINTR || errno == ECONNABORTED || errno == EPROTO))
+            continue;
+        if (connection < 0 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+            errno == ENOMEM)) {
+            std::this_thread::sleep_for(ACCEPT_BACKOFF);
+            continue;
+        }
+        if (connection < 0) {
+            // The listener is gone, the clients must not keep run() waiting
+            stop();
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            ::close(connection);
+            break;
+        }
+        connections.insert(connection);
+        // Nothing is kept per client thread, however many come and go
+        try {
+            std::thread(&TextureServer::serve, this, connection).detach();
+        } catch (const std::system_error &) {
+            connections.erase(connection);
+            ::close(connection);
+        }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    disconnected.wait(lock, [this]{ return connections.empty(); });
+}
+
+void TextureServer::stop()
+{
+    // Unblocks accept() and the reads of every client thread
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    if (listener >= 0)
+        ::shutdown(listener, SHUT_RDWR);
+    for (int connection : connections)
+        ::shutdown(connection, SHUT_RDWR);
+}
+
+void TextureServer::render()
+{
+#ifdef _OPENMP
+    if (threads > 0)
+        omp_set_num_threads(threads);
+#endif
+    // The OpenMP pool is created by the first parallel region, before the
+    // first request rather than during it
+    cv::Mat warm(2 * TileRenderer::DEFAULT_TILE_HEIGHT, 2 * TileRenderer::DEFAULT_TILE_WIDTH,
+        CV_8UC3);
+    TextureSpec spec(TextureSpec::FLAT, warm.size());
+    pattern_generation.getProceduralTexture(spec).render(RenderTarget(warm));
+
+    TextureService::RenderJob job;
+    while (jobs.pop(job)) {
+        bool drawn = true;
+        try {
+            cv::Mat pixels(job.spec.size, CV_8UC3, job.pixels);
+            pattern_generation.getProceduralTexture(job.spec).render(RenderTarget(pixels));
+        } catch (const std::exception &) {
+            // OpenCV errors, and allocations of a texture too large
+            drawn = false;
+        }
+        job.done->set_value(drawn);
+    }
+}
+
+void TextureServer::serve(int connection)
+{
+    TextureService::Hello hello;
+    std::memset(&hello, 0, sizeof(hello));
+    std::memcpy(hello.magic, TextureService::MAGIC, sizeof(hello.magic));
+    std::strcpy(hello.ring, ring_name.c_str());
+    hello.slots = slot_count;
+    hello.slot_size = slot_size;
+
+    TextureService::Request request;
+    bool open = writeAll(connection, &hello, sizeof(hello));
+    while (open && readAll(connection, &request, sizeof(request))) {
+        if (request.type == TextureService::RELEASE) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (request.slot < slot_count && owners[request.slot] == connection)
+                owners[request.slot] = -1;
+            continue;
+        }
+        TextureService::Reply reply;
+        std::memset(&reply, 0, sizeof(reply));
+        drawTexture(connection, request, reply);
+        open = writeAll(connection, &reply, sizeof(reply));
+    }
+
+    // The slots of a client that went away go back to the ring, before its
+    // descriptor can be reused by another one
+    std::lock_guard<std::mutex> lock(mutex);
+    std::replace(owners.begin(), owners.end(), connection, -1);
+    connections.erase(connection);
+    ::close(connection);
+    disconnected.notify_all();
+}
+
+void TextureServer::drawTexture(int connection, const TextureService::Request & request,
+    TextureService::Reply & reply)
+{
+    INSTRUMENT_SCOPE("service", 1);
+    const uint64_t size = (uint64_t) request.width * request.height * 3;
+    if (!validRequest(request)) {
+        reply.status = TextureService::BAD_REQUEST;
+        return;
+    }
+    if (size > slot_size) {
+        reply.status = TextureService::TOO_LARGE;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<int>::iterator free = std::find(owners.begin(), owners.end(), -1);
+        if (free == owners.end()) {
+            reply.status = TextureService::RING_FULL;
+            return;
+        }
+        *free = connection;
+        reply.slot = free - owners.begin();
+    }
+
+    TextureService::RenderJob job;
+    job.spec = TextureService::getSpec(request);
+    job.spec.rng = pattern_generation.getRandomEngine(request.index, request.stream);
+    job.pixels = static_cast<uchar *>(region.get_address()) + reply.slot * slot_size;
+    std::promise<bool> done;
+    job.done = &done;
+    std::future<bool> drawn = done.get_future();
+    jobs.push(std::move(job));
+
+    if (!drawn.get()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        owners[reply.slot] = -1;
+        reply.status = TextureService::BAD_REQUEST;
+        return;
+    }
+    reply.status = TextureService::OK;
+    reply.width = request.width;
+    reply.height = request.height;
+    reply.offset = reply.slot * slot_size;
+    reply.size = size;
+}
+
+TextureClient::TextureClient() :
+    connection(-1)
+{
+    std::memset(&hello, 0, sizeof(hello));
+}
+
+TextureClient::~TextureClient()
+{
+    close();
+}
+
+bool TextureClient::open(const std::string & socket_path)
+{
+    namespace bip = boost::interprocess;
+    close();
+    sockaddr_un address;
+    if (!socketAddress(socket_path, address))
+        return false;
+    connection = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0)
+        return false;
+    if (::connect(connection, reinterpret_cast<const sockaddr *>(&address),
+            sizeof(address)) != 0 ||
+        !readAll(connection, &hello, sizeof(hello)) ||
+        std::memcmp(hello.magic, TextureService::MAGIC, sizeof(hello.magic)) != 0) {
+        close();
+        return false;
+    }
+    hello.ring[sizeof(hello.ring) - 1] = '\0';
+
+    try {
+        bip::shared_memory_object shared(bip::open_only, hello.ring, bip::read_only);
+        bip::mapped_region whole(shared, bip::read_only);
+        memory.swap(shared);
+        region.swap(whole);
+    } catch (const bip::interprocess_exception &) {
+        close();
+        return false;
+    }
+    return region.get_size() >= hello.slots * hello.slot_size;
+}
+
+void TextureClient::close()
+{
+    if (connection >= 0)
+        ::close(connection);
+    connection = -1;
+    boost::interprocess::mapped_region().swap(region);
+    boost::interprocess::shared_memory_object().swap(memory);
+}
+
+bool TextureClient::request(const TextureService::Request & request,
+    TextureService::Reply & reply)
+{
+    return connection >= 0 && writeAll(connection, &request, sizeof(request)) &&
+        readAll(connection, &reply, sizeof(reply));
+}
+
+cv::Mat TextureClient::getPixels(const TextureService::Reply & reply) const
+{
+    CV_Assert(reply.status == TextureService::OK &&
+        reply.offset + reply.size <= region.get_size());
+    // The mapping is read only, writing the pixels faults
+    uchar * pixels = static_cast<uchar *>(region.get_address()) + reply.offset;
+    return cv::Mat(reply.height, reply.width, CV_8UC3, pixels);
+}
+
+bool TextureClient::release(const TextureService::Reply & reply)
+{
+    TextureService::Request request;
+    std::memset(&request, 0, sizeof(request));
+    request.type = TextureService::RELEASE;
+    request.slot = reply.slot;
+    return connection >= 0 && writeAll(connection, &request, sizeof(request));
+}
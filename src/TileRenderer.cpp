@@ -0,0 +1,133 @@
+#include "pattern_generation/TileRenderer.h"
+#include "pattern_generation/Instrumentation.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+RenderTarget::RenderTarget(cv::Mat & texture) :
+    texture(texture), sink(NULL), size(texture.size())
+{
+    CV_Assert(texture.type() == CV_8UC3);
+}
+
+RenderTarget::RenderTarget(const cv::Size & size, BandSink & sink) :
+    sink(&sink), size(size)
+{
+}
+
+RenderTarget::RenderTarget(const cv::Size & size, cv::Mat & texture, const cv::Point & origin) :
+    texture(texture), sink(NULL), size(size), origin(origin)
+{
+    CV_Assert(texture.type() == CV_8UC3);
+    CV_Assert(origin.x >= 0 && origin.y >= 0 &&
+        origin.x + texture.cols <= size.width && origin.y + texture.rows <= size.height);
+}
+
+cv::Size RenderTarget::getSize() const
+{
+    return size;
+}
+
+cv::Rect RenderTarget::getRegion() const
+{
+    return sink ? cv::Rect(cv::Point(), size) : cv::Rect(origin, texture.size());
+}
+
+cv::Mat RenderTarget::getTexture() const
+{
+    return texture;
+}
+
+BandSink * RenderTarget::getSink() const
+{
+    return sink;
+}
+
+TileRenderer::TileRenderer(const cv::Size & tile_size)
+{
+    setTileSize(tile_size);
+}
+
+void TileRenderer::setTileSize(const cv::Size & tile_size)
+{
+    this->tile_size = cv::Size(std::max(0, tile_size.width), std::max(1, tile_size.height));
+}
+
+cv::Size TileRenderer::getTileSize() const
+{
+    return tile_size;
+}
+
+int TileRenderer::getTileCount(const cv::Size & size) const
+{
+    // As split by renderRegion, with one region for the whole image
+    const int tile_width = tile_size.width > 0 ? std::min(tile_size.width, size.width) : size.width;
+    const int tile_height = std::min(tile_size.height, size.height);
+    if (tile_width <= 0 || tile_height <= 0)
+        return 0;
+    return ((size.width + tile_width - 1) / tile_width) *
+        ((size.height + tile_height - 1) / tile_height);
+}
+
+void TileRenderer::renderRegion(const TileKernel & kernel, cv::Mat & pixels,
+    const cv::Point & origin) const
+{
+    const int tile_width = tile_size.width > 0 && !kernel.fullWidth() ?
+        std::min(tile_size.width, pixels.cols) : pixels.cols;
+    const int tile_height = std::min(tile_size.height, pixels.rows);
+    if (tile_width <= 0 || tile_height <= 0)
+        return;
+
+    const int columns = (pixels.cols + tile_width - 1) / tile_width;
+    const int rows = (pixels.rows + tile_height - 1) / tile_height;
+    const cv::Rect bounds(origin, pixels.size());
+
+    // Row major tile order, so that threads starting at the same time write
+    // neighbouring memory. Tiles may cost very different amounts, e.g. the
+    // fractal octaves, hence the dynamic schedule. Inside an enclosing
+    // parallel region, e.g. a batch of textures, the calling thread draws
+    // every tile
+#ifdef _OPENMP
+    const bool nested = omp_in_parallel();
+#else
+    const bool nested = false;
+#endif
+    #pragma omp parallel for schedule(dynamic) if (!nested)
+    for (int t = 0; t < rows * columns; ++t) {
+        cv::Rect tile(origin.x + (t % columns) * tile_width,
+            origin.y + (t / columns) * tile_height, tile_width, tile_height);
+        kernel.drawTile(pixels, origin, tile & bounds);
+    }
+}
+
+void TileRenderer::render(const TileKernel & kernel, cv::Mat & texture) const
+{
+    renderRegion(kernel, texture, cv::Point());
+}
+
+void TileRenderer::render(const TileKernel & kernel, const RenderTarget & target) const
+{
+    const cv::Size size = target.getSize();
+    INSTRUMENT_SCOPE("render", (uint64_t) target.getRegion().area());
+
+    BandSink * sink = target.getSink();
+    if (!sink) {
+        cv::Mat texture = target.getTexture();
+        renderRegion(kernel, texture, target.getRegion().tl());
+        return;
+    }
+
+    // One row of tiles per band, drawn in parallel and handed to the sink
+    // in order. The band buffer is reused, whatever the image height
+    const int band_height = std::max(1, std::min(tile_size.height, size.height));
+    cv::Mat buffer(band_height, size.width, CV_8UC3);
+
+    sink->begin(size);
+    for (int y = 0; y < size.height; y += band_height) {
+        cv::Mat band = buffer.rowRange(0, std::min(band_height, size.height - y));
+        renderRegion(kernel, band, cv::Point(0, y));
+        sink->writeBand(band, y);
+    }
+    sink->end();
+}
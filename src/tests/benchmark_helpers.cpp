@@ -0,0 +1,127 @@
+#include "benchmark_helpers.h"
+#include "pattern_generation/PerlinNoise.h"
+
+// C libraries
+#include <stdlib.h>
+
+// C++ libraries
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+// Baseline results. Boost bind, used by the JSON parser, otherwise warns
+// about its global placeholders
+#define BOOST_BIND_GLOBAL_PLACEHOLDERS
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+std::atomic<size_t> allocations(0);
+
+void * operator new(std::size_t size)
+{
+    ++allocations;
+    void * p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void * p) noexcept
+{
+    free(p);
+}
+
+//////////////////////////////////////////////////
+int maxThreads(const Options & options)
+{
+#ifdef _OPENMP
+    return options.threads > 0 ? options.threads : omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+//////////////////////////////////////////////////
+void setThreads(const int & threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+//////////////////////////////////////////////////
+bool samePixels(const cv::Mat & a, const cv::Mat & b)
+{
+    if (a.rows != b.rows || a.cols != b.cols)
+        return false;
+    for (int i = 0; i < a.rows; ++i)
+        if (!std::equal(a.ptr<uchar>(i), a.ptr<uchar>(i) + a.cols * 3, b.ptr<uchar>(i)))
+            return false;
+    return true;
+}
+
+//////////////////////////////////////////////////
+int maxDifference(const cv::Mat & a, const cv::Mat & b)
+{
+    int difference = 0;
+    for (int i = 0; i < a.rows; ++i)
+        for (int j = 0; j < a.cols * 3; ++j)
+            difference = std::max(difference, std::abs(a.ptr<uchar>(i)[j] - b.ptr<uchar>(i)[j]));
+    return difference;
+}
+
+//////////////////////////////////////////////////
+Table::Table(const std::vector<Column> & columns) :
+    columns(columns)
+{
+    for (const Column & column : columns)
+        std::cout << std::setw(column.width) << column.name;
+    std::cout << std::endl;
+}
+
+//////////////////////////////////////////////////
+std::string suiteKey(const std::string & name, const int & resolution, const int & threads)
+{
+    return name + "/" + std::to_string(resolution) + "/threads:" + std::to_string(threads);
+}
+
+//////////////////////////////////////////////////
+bool writeSuite(const std::string & file, const Options & options,
+    const std::vector<SuiteResult> & results)
+{
+    std::ofstream ofs(file);
+    ofs << std::setprecision(9) << "{\n  \"context\": {\"seed\": " << options.seed
+        << ", \"repetitions\": " << options.repetitions
+        << ", \"max_threads\": " << maxThreads(options)
+        << ", \"simd\": " << (int) PerlinNoise::simdLevel() << "},\n  \"benchmarks\": [\n";
+    for (size_t k = 0; k < results.size(); ++k) {
+        const SuiteResult & r = results[k];
+        ofs << "    {\"name\": \"" << suiteKey(r.name, r.resolution, r.threads)
+            << "\", \"resolution\": " << r.resolution << ", \"threads\": " << r.threads
+            << ", \"time\": " << r.time << ", \"pixels_per_second\": " << r.pixels_per_second
+            << ", \"bytes_per_second\": " << r.bytes_per_second
+            << ", \"allocations\": " << r.allocations << "}"
+            << (k + 1 < results.size() ? ",\n" : "\n");
+    }
+    ofs << "  ]\n}\n";
+    return (bool) ofs;
+}
+
+//////////////////////////////////////////////////
+bool readSuite(const std::string & file, std::map<std::string, double> & times)
+{
+    namespace pt = boost::property_tree;
+    pt::ptree results;
+    try {
+        pt::read_json(file, results);
+    } catch (const pt::json_parser_error & e) {
+        std::cout << "[ERROR] Could not read " << file << ": " << e.what() << std::endl;
+        return false;
+    }
+    for (const pt::ptree::value_type & v : results.get_child("benchmarks", pt::ptree()))
+        times[v.second.get<std::string>("name", "")] = v.second.get<double>("time", 0);
+    return true;
+}
@@ -0,0 +1,210 @@
+#ifndef BENCHMARK_HELPERS_H
+#define BENCHMARK_HELPERS_H
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// Heap allocations made through operator new, by any thread
+extern std::atomic<size_t> allocations;
+
+/// Benchmark options
+struct Options
+{
+    /// Image resolution
+    int resolution;
+    /// Timed repetitions
+    int repetitions;
+    /// Maximum number of threads, 0 for all available
+    int threads;
+    /// Random seed
+    uint64_t seed;
+    /// Suite results file, JSON
+    std::string output;
+    /// Suite results to compare against, JSON
+    std::string baseline;
+};
+
+/**
+ * @brief      Times a function.
+ *
+ * @param      repetitions  The number of runs
+ * @param      function     The function
+ *
+ * @return     The best time, in seconds.
+ */
+template <typename Function>
+double bestTime(const int & repetitions, Function function)
+{
+    double best = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        if (r == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+/**
+ * @brief      Gets the number of threads to benchmark up to.
+ *
+ * @param      options  The options
+ *
+ * @return     The -j threads, or every available one.
+ */
+int maxThreads(const Options & options);
+
+/**
+ * @brief      Sets the number of OpenMP threads of the calling thread.
+ *
+ * @param      threads  The threads
+ */
+void setThreads(const int & threads);
+
+/**
+ * @brief      Compares two 8-bit, 3 channel images.
+ *
+ * @return     True when they have the same size and pixels.
+ */
+bool samePixels(const cv::Mat & a, const cv::Mat & b);
+
+/**
+ * @brief      Gets the largest channel difference of two 8-bit, 3 channel
+ *             images of the same size.
+ *
+ * @return     The difference, in intensity levels.
+ */
+int maxDifference(const cv::Mat & a, const cv::Mat & b);
+
+/// A column of a results table
+struct Column
+{
+    /// Header
+    std::string name;
+    /// Width, headers and values are right aligned
+    int width;
+    /// Digits after the decimal point of floating point values
+    int precision;
+    /// Unit printed right after every value, e.g. "%"
+    std::string suffix;
+    /// Scientific rather than fixed notation
+    bool scientific;
+
+    Column(const std::string & name, int width, int precision = 3,
+        const std::string & suffix = "", bool scientific = false) :
+        name(name), width(width), precision(precision), suffix(suffix),
+        scientific(scientific) {}
+};
+
+/**
+ * @brief      Results table printed to stdout, one row at a time.
+ */
+class Table
+{
+    private:
+        /// Columns
+        std::vector<Column> columns;
+
+        /**
+         * @brief      Prints one value in its column.
+         *
+         * @param      c      The column
+         * @param      value  The value
+         */
+        template <typename T>
+        void cell(std::size_t c, const T & value) const
+        {
+            const Column & column = columns[c];
+            std::ostringstream text;
+            text << (column.scientific ? std::scientific : std::fixed)
+                << std::setprecision(column.precision) << value << column.suffix;
+            std::cout << std::setw(column.width) << text.str();
+        }
+
+    public:
+
+        /**
+         * @brief      Constructor, prints the header.
+         *
+         * @param      columns  The columns
+         */
+        explicit Table(const std::vector<Column> & columns);
+
+        /**
+         * @brief      Prints a row, one value per column.
+         *
+         * @param      values  The values
+         */
+        template <typename... Values>
+        void row(const Values &... values) const
+        {
+            std::size_t c = 0;
+            const int expand[] = {(cell(c++, values), 0)...};
+            (void) expand;
+            std::cout << std::endl;
+        }
+};
+
+/// One measurement of the suite
+struct SuiteResult
+{
+    /// Case name, unique per resolution and thread count
+    std::string name;
+    /// Image resolution, or 0 when not drawing a texture
+    int resolution;
+    /// Number of threads
+    int threads;
+    /// Best time per iteration, in seconds
+    double time;
+    /// Pixels, or noise samples, per second
+    double pixels_per_second;
+    /// Uncompressed image bytes per second
+    double bytes_per_second;
+    /// Heap allocations per iteration, once warmed up
+    double allocations;
+};
+
+/**
+ * @brief      Gets the name of a suite case, as saved in the results.
+ *
+ * @param      name        The case
+ * @param      resolution  The image resolution
+ * @param      threads     The number of threads
+ *
+ * @return     The key, e.g. "perlin/1024/threads:4".
+ */
+std::string suiteKey(const std::string & name, const int & resolution, const int & threads);
+
+/**
+ * @brief      Saves suite results as JSON, written by hand.
+ *
+ * @param      file     The file
+ * @param      options  The options, saved as the context
+ * @param      results  The results
+ *
+ * @return     False when the file could not be written.
+ */
+bool writeSuite(const std::string & file, const Options & options,
+    const std::vector<SuiteResult> & results);
+
+/**
+ * @brief      Reads the times of saved suite results.
+ *
+ * @param      file   The file
+ * @param      times  The best time of every case, by key
+ *
+ * @return     False when the file could not be read, after printing why.
+ */
+bool readSuite(const std::string & file, std::map<std::string, double> & times);
+
+#endif
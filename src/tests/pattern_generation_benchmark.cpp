@@ -0,0 +1,1438 @@
+/*
+ *  Copyright (C) 2018 João Borrego and Rui Figueiredo
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*!
+
+    \brief Performance and accuracy checks for the pattern generators
+
+    \author Rui Figueiredo : ruipimentelfigueiredo
+    \author João Borrego   : jsbruglie
+
+*/
+
+#include "pattern_generation/PatternGeneration.h"
+#include "pattern_generation/DdsWriter.h"
+#include "pattern_generation/TextureArchive.h"
+#include "pattern_generation/TextureService.h"
+#include "benchmark_helpers.h"
+
+// C libraries
+#include <stdlib.h>
+#include <unistd.h>
+
+// C++ libraries
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+// File system
+#include <boost/filesystem.hpp>
+
+/// Default image resolution
+#define ARG_IMG_RESOLUTION_DEFAULT  4096
+/// Default number of timed repetitions, the best one is reported
+#define ARG_REPETITIONS_DEFAULT     3
+/// Default seed
+#define ARG_SEED_DEFAULT            1
+/// Minimum parallel efficiency for the scaling check to pass
+#define SCALING_MIN_EFFICIENCY      0.75
+/// Number of samples for the batch noise checks
+#define SIMD_SAMPLES                (1 << 16)
+/// Maximum absolute difference between batch and scalar noise
+#define SIMD_TOLERANCE              1e-5
+/// Lattice cells across the texture for the row evaluation check
+#define ROW_CELLS                   16
+/// Largest octave count for the fractal noise benchmark
+#define FRACTAL_MAX_OCTAVES         8
+/// Maximum absolute difference between fractal rows and single points
+#define FRACTAL_TOLERANCE           1e-4
+
+/// Number of textures generated per type for the allocation check
+#define ALLOCATION_TEXTURES         4
+/// Number of small textures written for the archive benchmark
+#define ARCHIVE_TEXTURES            2000
+/// Resolution of the archive benchmark textures
+#define ARCHIVE_RESOLUTION          64
+/// Number of small textures drawn for the permutation table benchmark
+#define TABLE_TEXTURES              20000
+/// Resolution of the permutation table benchmark textures
+#define TABLE_RESOLUTION            16
+/// Smallest fraction of the parallel memset bandwidth flat and chess fills
+/// must reach
+#define FILL_MIN_FRACTION           0.75
+/// Smallest image checked against FILL_MIN_FRACTION, below it the pattern
+/// setup is a large part of the time
+#define FILL_MIN_BYTES              (1 << 20)
+/// Number of textures of the batch benchmark
+#define BATCH_TEXTURES              500
+/// Resolution of the batch benchmark textures
+#define BATCH_RESOLUTION            256
+/// Number of random regions checked per pattern and size
+#define REGION_SAMPLES              16
+/// Side of the regions of the lazy texture benchmark
+#define REGION_SIZE                 64
+/// Largest difference of the exact mip levels from box filtering the texture
+#define MIPMAP_TOLERANCE            1
+/// Number of slots of the service benchmark ring
+#define SERVICE_SLOTS               4
+/// Smallest resolution of the suite, quadrupled in area up to -r
+#define SUITE_MIN_RESOLUTION        256
+/// Number of point samples for the suite noise case
+#define SUITE_NOISE_SAMPLES         (1 << 20)
+/// Largest slowdown against the baseline before the suite reports a regression
+#define SUITE_REGRESSION_TOLERANCE  0.15
+
+//////////////////////////////////////////////////
+const std::string getUsage(const char* argv_0)
+{
+    return \
+        "usage:   " + std::string(argv_0) + " <mode> [options]\n" +
+        "modes:   scaling   Perlin random color texture speedup from 1 to N threads\n" +
+        "         simd      Batch and row noise throughput and accuracy\n" +
+        "         precision Perlin texture error and speed per precision mode\n" +
+        "         octaves   Fractal noise texture speed and row accuracy per octave count\n" +
+        "         allocs    Heap allocations per texture drawn into a reused image\n" +
+        "         tiles     Texture throughput drawn in row strips and in tiles\n" +
+        "         stream    Texture throughput and band memory when streamed to a sink\n" +
+        "         archive   Small texture write and read time, one file each or archived\n" +
+        "         tables    Small noise texture and setup time with and without permutation table pools\n" +
+        "         kernels   Specialized gradient and Perlin kernels against runtime branching loops\n" +
+        "         fill      Flat and chess texture bandwidth against memset\n" +
+        "         batch     Small texture throughput drawn one by one and in a batch\n" +
+        "         regions   Lazy texture regions against whole textures, time and equality\n" +
+        "         mipmaps   Mip chains drawn from the definition against downsampling, and DDS size\n" +
+        "         service   Textures requested from a resident server against drawn in process\n" +
+        "         suite     Every generator, the noise and the whole pipeline per resolution\n" +
+        "                   and thread count, optionally saved and checked against a baseline\n" +
+        "options: -r <image resolution>\n" +
+        "         -n <repetitions>\n" +
+        "         -j <maximum number of threads>\n" +
+        "         -S <random seed>\n" +
+        "         -o <suite results JSON file>\n" +
+        "         -b <suite baseline JSON file>\n";
+}
+
+//////////////////////////////////////////////////
+int benchmarkScaling(const Options & options)
+{
+    PatternGeneration pattern_generation(options.seed);
+    const int max_threads = maxThreads(options);
+    double reference = 0;
+    bool ok = true;
+
+    std::cout << "Perlin noise, random colors, " << options.resolution << "x"
+        << options.resolution << std::endl;
+    const Table table({Column("threads", 8), Column("time [s]", 12), Column("speedup", 12),
+        Column("efficiency", 12)});
+
+    std::vector<int> counts;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(max_threads);
+
+    for (const int & threads : counts) {
+        setThreads(threads);
+        double time = bestTime(options.repetitions, [&]{
+            RandomEngine rng = pattern_generation.getRandomEngine(0, 0);
+            pattern_generation.getPerlinNoiseTexture(options.resolution, rng, true);
+        });
+        if (threads == 1)
+            reference = time;
+        double speedup = reference / time;
+        double efficiency = speedup / threads;
+        ok = ok && efficiency >= SCALING_MIN_EFFICIENCY;
+
+        table.row(threads, time, speedup, efficiency);
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Parallel efficiency below " << SCALING_MIN_EFFICIENCY << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkSimd(const Options & options)
+{
+    const char * names[] = {"scalar", "sse4.1", "avx2", "avx512"};
+    RandomEngine rng(options.seed);
+    PerlinNoise pn(rng);
+
+    // Texture coordinates, plus a wide range covering many lattice cells
+    // and negative values
+    std::vector<float> x(SIMD_SAMPLES), y(SIMD_SAMPLES), out(SIMD_SAMPLES);
+    for (size_t k = 0; k < x.size(); ++k) {
+        double range = k < x.size() / 2 ? 1.0 : 256.0;
+        x[k] = (float) ((rng.uniformReal() * 2 - 1) * range);
+        y[k] = (float) ((rng.uniformReal() * 2 - 1) * range);
+    }
+    const float z = (float) rng.uniformReal();
+
+    std::vector<double> reference(x.size());
+    double scalar_time = bestTime(options.repetitions, [&]{
+        for (size_t k = 0; k < x.size(); ++k)
+            reference[k] = pn.noise(x[k], y[k], z);
+    });
+
+    const Table batches({Column("isa", 10), Column("ns/sample", 14), Column("speedup", 12),
+        Column("max error", 14, 2, "", true)});
+    batches.row("double", scalar_time * 1e9 / x.size(), 1.0, 0.0);
+
+    bool ok = true;
+    for (int level = PerlinNoise::SIMD_SCALAR; level <= PerlinNoise::simdLevel(); ++level) {
+        double time = bestTime(options.repetitions, [&]{
+            pn.noise(x.data(), y.data(), z, out.data(), x.size(), (PerlinNoise::SimdLevel) level);
+        });
+        double error = 0;
+        for (size_t k = 0; k < x.size(); ++k)
+            error = std::max(error, std::abs(out[k] - reference[k]));
+        ok = ok && error <= SIMD_TOLERANCE;
+
+        batches.row(names[level], time * 1e9 / x.size(), scalar_time / time, error);
+    }
+
+    // Three planes at once, as for the Perlin texture channels, against
+    // three separate batches
+    std::vector<float> zs[3], ns[3];
+    for (int c = 0; c < 3; ++c) {
+        zs[c].assign(x.size(), z + 0.25f * c);
+        ns[c].resize(x.size());
+    }
+    const float * zp[3] = {zs[0].data(), zs[1].data(), zs[2].data()};
+    float * np[3] = {ns[0].data(), ns[1].data(), ns[2].data()};
+
+    std::cout << std::endl;
+    const Table planes({Column("isa", 10), Column("ns/pixel", 14), Column("ns/pixel 3x1", 14),
+        Column("speedup", 12)});
+    for (int level = PerlinNoise::SIMD_SCALAR; level <= PerlinNoise::simdLevel(); ++level) {
+        double separate = bestTime(options.repetitions, [&]{
+            for (int c = 0; c < 3; ++c)
+                pn.noise(x.data(), y.data(), zp[c], np[c], x.size(), (PerlinNoise::SimdLevel) level);
+        });
+        std::vector<float> separate_out[3] = {ns[0], ns[1], ns[2]};
+        double fused = bestTime(options.repetitions, [&]{
+            pn.noise(x.data(), y.data(), zp, np, 3, x.size(), (PerlinNoise::SimdLevel) level);
+        });
+        for (int c = 0; c < 3; ++c)
+            ok = ok && ns[c] == separate_out[c];
+
+        planes.row(names[level], fused * 1e9 / x.size(), separate * 1e9 / x.size(),
+            separate / fused);
+    }
+
+    // Row evaluation over a square texture spanning ROW_CELLS lattice cells
+    const size_t width = (size_t) std::sqrt((double) SIMD_SAMPLES);
+    std::vector<double> xd(width), row_reference(width * width), row_out(width * width);
+    std::vector<float> xf(width), row_outf(width * width);
+    for (size_t j = 0; j < width; ++j) {
+        xd[j] = (ROW_CELLS * (double) j) / width;
+        xf[j] = (float) xd[j];
+    }
+    double reference_time = bestTime(options.repetitions, [&]{
+        for (size_t i = 0; i < width; ++i)
+            for (size_t j = 0; j < width; ++j)
+                row_reference[i * width + j] = pn.noise(xd[j], (ROW_CELLS * (double) i) / width, z);
+    });
+    double row_time = bestTime(options.repetitions, [&]{
+        for (size_t i = 0; i < width; ++i)
+            pn.noiseRow(xd.data(), (ROW_CELLS * (double) i) / width, (double) z,
+                row_out.data() + i * width, width);
+    });
+    double rowf_time = bestTime(options.repetitions, [&]{
+        for (size_t i = 0; i < width; ++i)
+            pn.noiseRow(xf.data(), (float) ((ROW_CELLS * (double) i) / width), z,
+                row_outf.data() + i * width, width);
+    });
+    double row_error = 0, rowf_error = 0;
+    for (size_t k = 0; k < row_reference.size(); ++k) {
+        row_error = std::max(row_error, std::abs(row_out[k] - row_reference[k]));
+        rowf_error = std::max(rowf_error, std::abs(row_outf[k] - row_reference[k]));
+    }
+    ok = ok && row_error <= SIMD_TOLERANCE && rowf_error <= SIMD_TOLERANCE;
+
+    std::cout << std::endl;
+    const Table rows({Column("row", 10), Column("ns/sample", 14), Column("speedup", 12),
+        Column("max error", 14, 2, "", true)});
+    const double row_times[] = {row_time, rowf_time}, row_errors[] = {row_error, rowf_error};
+    const char * row_names[] = {"double", "float"};
+    for (int r = 0; r < 2; ++r)
+        rows.row(row_names[r], row_times[r] * 1e9 / row_reference.size(),
+            reference_time / row_times[r], row_errors[r]);
+
+    if (!ok)
+        std::cout << "[ERROR] Batch or row noise differs from the scalar reference by more than "
+            << SIMD_TOLERANCE << " or the fused planes differ from separate batches" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkPrecision(const Options & options)
+{
+    const char * names[] = {"double", "float", "fixed"};
+    PatternGeneration pattern_generation(options.seed);
+    // Compared before the color conversion, the channels are the wood rings
+    pattern_generation.setColorSpace(PatternGeneration::COLOR_SPACE_LAB);
+
+    for (int random_colors = 0; random_colors < 2; ++random_colors) {
+        std::cout << "Perlin noise, " << (random_colors ? "random" : "fixed")
+            << " colors, " << options.resolution << "x" << options.resolution << std::endl;
+        const Table table({Column("precision", 10), Column("time [s]", 12),
+            Column("max diff", 12), Column("mean diff", 12), Column("pixels diff", 14, 3, "%")});
+
+        cv::Mat reference;
+        for (int precision = PatternGeneration::PRECISION_DOUBLE;
+            precision <= PatternGeneration::PRECISION_FIXED; ++precision) {
+            pattern_generation.setPrecision((PatternGeneration::Precision) precision);
+            cv::Mat image;
+            double time = bestTime(options.repetitions, [&]{
+                RandomEngine rng = pattern_generation.getRandomEngine(0, 0);
+                image = pattern_generation.getPerlinNoiseTexture(
+                    options.resolution, rng, random_colors, 0.3, 0.5, 0.7);
+            });
+            if (precision == PatternGeneration::PRECISION_DOUBLE)
+                reference = image;
+
+            // Per channel 8-bit differences against the double reference. The
+            // rings wrap from 255 to 0, so a value just across a ring edge
+            // is off by one, not by 255
+            int max_diff = 0;
+            double sum_diff = 0;
+            size_t pixels = 0;
+            for (int i = 0; i < image.rows; ++i) {
+                for (int j = 0; j < image.cols; ++j) {
+                    const cv::Vec3b & a = image.at<cv::Vec3b>(i, j);
+                    const cv::Vec3b & b = reference.at<cv::Vec3b>(i, j);
+                    int pixel_diff = 0;
+                    for (int c = 0; c < 3; ++c) {
+                        int diff = std::abs((int) a[c] - (int) b[c]);
+                        diff = std::min(diff, 256 - diff);
+                        pixel_diff = std::max(pixel_diff, diff);
+                        sum_diff += diff;
+                    }
+                    max_diff = std::max(max_diff, pixel_diff);
+                    pixels += pixel_diff > 0;
+                }
+            }
+
+            table.row(names[precision], time, max_diff, sum_diff / (3.0 * image.total()),
+                100.0 * pixels / image.total());
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////
+int benchmarkOctaves(const Options & options)
+{
+    const char * names[] = {"fbm", "turbulence", "ridged"};
+    PatternGeneration pattern_generation(options.seed);
+    const double pixels = (double) options.resolution * options.resolution;
+    bool ok = true;
+
+    std::cout << "Fractal noise, " << options.resolution << "x" << options.resolution << std::endl;
+    const Table table({Column("type", 12), Column("octaves", 8), Column("ns/pixel", 12),
+        Column("ns/sample", 12), Column("ns/octave", 14), Column("max error", 14, 2, "", true)});
+
+    std::vector<float> x(options.resolution), out(options.resolution);
+    for (int j = 0; j < options.resolution; ++j)
+        x[j] = 4.0f * j / options.resolution;
+
+    for (int type = FractalNoise::FBM; type <= FractalNoise::RIDGED; ++type) {
+        for (int octaves = 1; octaves <= FRACTAL_MAX_OCTAVES; ++octaves) {
+            // Whole texture, three channels per pixel plus the color conversion
+            double texture_time = bestTime(options.repetitions, [&]{
+                RandomEngine rng = pattern_generation.getRandomEngine(0, 0);
+                pattern_generation.getFractalNoiseTexture(options.resolution, rng,
+                    (FractalNoise::Type) type, octaves);
+            });
+
+            // Noise alone, one sample per pixel
+            RandomEngine rng(options.seed);
+            FractalNoise fn(rng, (FractalNoise::Type) type, octaves);
+            double noise_time = bestTime(options.repetitions, [&]{
+                for (int i = 0; i < options.resolution; ++i)
+                    fn.noiseRow(x.data(), 4.0f * i / options.resolution, 0.5f, out.data(), out.size());
+            });
+
+            // Rows against single point evaluation
+            double error = 0;
+            for (int i = 0; i < options.resolution; i += std::max(1, options.resolution / 16)) {
+                float y = 4.0f * i / options.resolution;
+                fn.noiseRow(x.data(), y, 0.5f, out.data(), out.size());
+                for (int j = 0; j < options.resolution; ++j)
+                    error = std::max(error, (double) std::abs(out[j] - fn.noise(x[j], y, 0.5f)));
+            }
+            ok = ok && error <= FRACTAL_TOLERANCE;
+
+            table.row(names[type], octaves, texture_time * 1e9 / pixels, noise_time * 1e9 / pixels,
+                noise_time * 1e9 / (pixels * octaves), error);
+        }
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Fractal noise rows differ from single points by more than "
+            << FRACTAL_TOLERANCE << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkAllocations(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient", "perlin", "fractal"};
+    const int size = options.resolution;
+    PatternGeneration pattern_generation(options.seed);
+    cv::Mat texture(size, size, CV_8UC3);
+    const RenderTarget target(texture);
+    const uchar * data = texture.data;
+    bool ok = true;
+
+    // Draws texture type t with the parameters of texture k
+    auto draw = [&](int t, unsigned k) {
+        RandomEngine rng = pattern_generation.getRandomEngine(k, t);
+        cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+        cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+        switch (t) {
+        case 0: pattern_generation.getFlatTexture(color1, target); break;
+        case 1: pattern_generation.getChessTexture(color1, color2, size / 8 + 1, target); break;
+        case 2: pattern_generation.getGradientTexture(color1, color2, target, k % 2); break;
+        case 3: pattern_generation.getPerlinNoiseTexture(rng, target, k % 2); break;
+        default: pattern_generation.getFractalNoiseTexture(rng, target); break;
+        }
+    };
+
+    const Table table({Column("texture", 10), Column("allocations", 14)});
+    for (int t = 0; t < 5; ++t) {
+        // The first texture sizes the per thread buffers
+        draw(t, 0);
+        allocations = 0;
+        for (unsigned k = 1; k <= ALLOCATION_TEXTURES; ++k)
+            draw(t, k);
+        size_t count = allocations;
+        ok = ok && count == 0 && texture.data == data;
+        table.row(names[t], count);
+    }
+
+    // A raw buffer with padded rows gets the same pixels as an image
+    const size_t stride = size * 3 + 64;
+    std::vector<uint8_t> buffer(stride * size);
+    RandomEngine rng_image = pattern_generation.getRandomEngine(0, 3);
+    RandomEngine rng_buffer = pattern_generation.getRandomEngine(0, 3);
+    pattern_generation.getPerlinNoiseTexture(rng_image, target);
+    pattern_generation.getPerlinNoiseTexture(rng_buffer, buffer.data(), size, size, stride);
+    for (int i = 0; i < size; ++i)
+        ok = ok && std::equal(texture.ptr<uchar>(i), texture.ptr<uchar>(i) + size * 3,
+            buffer.data() + i * stride);
+
+    if (!ok)
+        std::cout << "[ERROR] Drawing into a reused image allocated memory or a strided"
+            " buffer differs from an image" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkTiles(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient h", "gradient v", "perlin", "fractal"};
+    const int size = options.resolution;
+    const double bytes = 3.0 * size * size;
+    PatternGeneration pattern_generation(options.seed);
+    cv::Mat strips(size, size, CV_8UC3), tiles(size, size, CV_8UC3);
+    bool ok = true;
+
+    auto draw = [&](int t, cv::Mat & texture) {
+        const RenderTarget target(texture);
+        RandomEngine rng = pattern_generation.getRandomEngine(0, t);
+        cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+        cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+        switch (t) {
+        case 0: pattern_generation.getFlatTexture(color1, target); break;
+        case 1: pattern_generation.getChessTexture(color1, color2, size / 8 + 1, target); break;
+        case 2: pattern_generation.getGradientTexture(color1, color2, target, false); break;
+        case 3: pattern_generation.getGradientTexture(color1, color2, target, true); break;
+        case 4: pattern_generation.getPerlinNoiseTexture(rng, target, true); break;
+        default: pattern_generation.getFractalNoiseTexture(rng, target); break;
+        }
+    };
+
+    const cv::Size tile_size = pattern_generation.getTileSize();
+    std::cout << size << "x" << size << ", tiles of " << tile_size.width << "x"
+        << tile_size.height << std::endl;
+    const Table table({Column("texture", 12), Column("strips [s]", 12), Column("GB/s", 12),
+        Column("tiles [s]", 12), Column("GB/s", 12)});
+    for (int t = 0; t < 6; ++t) {
+        pattern_generation.setTileSize(cv::Size(0, 1));
+        double strip_time = bestTime(options.repetitions, [&]{ draw(t, strips); });
+        pattern_generation.setTileSize(tile_size);
+        double tile_time = bestTime(options.repetitions, [&]{ draw(t, tiles); });
+
+        // The tiling must not change a single pixel
+        for (int i = 0; i < size && ok; ++i)
+            ok = std::equal(strips.ptr<uchar>(i), strips.ptr<uchar>(i) + size * 3,
+                tiles.ptr<uchar>(i));
+
+        table.row(names[t], strip_time, bytes / strip_time * 1e-9, tile_time,
+            bytes / tile_time * 1e-9);
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Textures drawn in tiles differ from row strips" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Compares streamed bands with an image drawn in place
+class CompareSink : public BandSink
+{
+    public:
+        /// Image drawn in place
+        cv::Mat reference;
+        /// Largest band received, in bytes
+        size_t max_band_bytes = 0;
+        /// Whether every band matched the reference
+        bool equal = true;
+
+        void writeBand(const cv::Mat & band, int band_y)
+        {
+            max_band_bytes = std::max(max_band_bytes, band.total() * band.elemSize());
+            for (int i = 0; i < band.rows && equal; ++i)
+                equal = std::equal(band.ptr<uchar>(i), band.ptr<uchar>(i) + band.cols * 3,
+                    reference.ptr<uchar>(band_y + i));
+        }
+};
+
+//////////////////////////////////////////////////
+int benchmarkStream(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient h", "gradient v", "perlin", "fractal"};
+    const int size = options.resolution;
+    const double bytes = 3.0 * size * size;
+    PatternGeneration pattern_generation(options.seed);
+    CompareSink sink;
+    sink.reference.create(size, size, CV_8UC3);
+    bool ok = true;
+
+    auto draw = [&](int t, const RenderTarget & target) {
+        RandomEngine rng = pattern_generation.getRandomEngine(0, t);
+        cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+        cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+        switch (t) {
+        case 0: pattern_generation.getFlatTexture(color1, target); break;
+        case 1: pattern_generation.getChessTexture(color1, color2, size / 8 + 1, target); break;
+        case 2: pattern_generation.getGradientTexture(color1, color2, target, false); break;
+        case 3: pattern_generation.getGradientTexture(color1, color2, target, true); break;
+        case 4: pattern_generation.getPerlinNoiseTexture(rng, target, true); break;
+        default: pattern_generation.getFractalNoiseTexture(rng, target); break;
+        }
+    };
+
+    std::cout << size << "x" << size << ", image of " << bytes / (1 << 20) << " MB" << std::endl;
+    const Table table({Column("texture", 12), Column("in place [s]", 14),
+        Column("stream [s]", 12), Column("GB/s", 12), Column("band [MB]", 12)});
+    for (int t = 0; t < 6; ++t) {
+        double place_time = bestTime(options.repetitions,
+            [&]{ draw(t, RenderTarget(sink.reference)); });
+        sink.max_band_bytes = 0;
+        double stream_time = bestTime(options.repetitions,
+            [&]{ draw(t, RenderTarget(cv::Size(size, size), sink)); });
+        ok = ok && sink.equal;
+
+        table.row(names[t], place_time, stream_time, bytes / stream_time * 1e-9,
+            sink.max_band_bytes / (double) (1 << 20));
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Streamed textures differ from the ones drawn in place" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkArchive(const Options & options)
+{
+    namespace fs = boost::filesystem;
+    PatternGeneration pattern_generation(options.seed);
+    cv::Mat texture(ARCHIVE_RESOLUTION, ARCHIVE_RESOLUTION, CV_8UC3);
+    const RenderTarget target(texture);
+    std::vector<std::vector<uchar> > files(ARCHIVE_TEXTURES);
+    for (int k = 0; k < ARCHIVE_TEXTURES; ++k) {
+        RandomEngine rng = pattern_generation.getRandomEngine(k, 3);
+        pattern_generation.getPerlinNoiseTexture(rng, target);
+        cv::imencode(".jpg", texture, files[k]);
+    }
+    auto name = [](int k) { return "perlin_" + std::to_string(k) + ".jpg"; };
+
+    const fs::path dir = fs::temp_directory_path() / fs::unique_path("pattern_generation_%%%%%%%%");
+    const std::string archive_file = (dir / "textures.pga").string();
+    fs::create_directories(dir / "files");
+    bool ok = true;
+
+    double files_write = bestTime(options.repetitions, [&]{
+        for (int k = 0; k < ARCHIVE_TEXTURES; ++k) {
+            std::ofstream ofs((dir / "files" / name(k)).string(), std::ios::binary);
+            ofs.write(reinterpret_cast<const char *>(files[k].data()), files[k].size());
+        }
+    });
+    double archive_write = bestTime(options.repetitions, [&]{
+        // An existing archive would be appended to
+        fs::remove(archive_file);
+        TextureArchiveWriter archive(archive_file);
+        for (int k = 0; k < ARCHIVE_TEXTURES; ++k)
+            archive.add(name(k), "", files[k].data(), files[k].size());
+        ok = archive.close() && ok;
+    });
+
+    // Read back and compared, through the page cache either way
+    std::vector<uchar> buffer;
+    double files_read = bestTime(options.repetitions, [&]{
+        for (int k = 0; k < ARCHIVE_TEXTURES; ++k) {
+            std::ifstream ifs((dir / "files" / name(k)).string(), std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            ok = ok && buffer.size() == files[k].size() &&
+                std::equal(buffer.begin(), buffer.end(), files[k].begin());
+        }
+    });
+    double archive_read = bestTime(options.repetitions, [&]{
+        TextureArchiveReader archive;
+        ok = archive.open(archive_file) && archive.getEntries().size() == ARCHIVE_TEXTURES && ok;
+        for (int k = 0; k < ARCHIVE_TEXTURES && ok; ++k) {
+            const TextureArchive::Entry * entry = archive.find(name(k));
+            ok = entry && entry->size == files[k].size() &&
+                std::equal(files[k].begin(), files[k].end(), archive.getData(*entry));
+        }
+    });
+
+    // Cut in the middle of the last texture, as by a crash: the others are
+    // still read, and the next writer drops the cut record and appends
+    const std::size_t last = ARCHIVE_TEXTURES - 1;
+    fs::resize_file(archive_file, fs::file_size(archive_file) - files[last].size() / 2);
+    {
+        TextureArchiveReader archive;
+        ok = archive.open(archive_file) && archive.getEntries().size() == last &&
+            !archive.find(name(last)) && ok;
+    }
+    {
+        TextureArchiveWriter archive(archive_file);
+        ok = archive.add(name(last), "", files[last].data(), files[last].size()) &&
+            archive.close() && ok;
+    }
+    {
+        TextureArchiveReader archive;
+        ok = archive.open(archive_file) && archive.getEntries().size() == ARCHIVE_TEXTURES && ok;
+        const TextureArchive::Entry * entry = ok ? archive.find(name(last)) : NULL;
+        ok = entry && entry->size == files[last].size() &&
+            std::equal(files[last].begin(), files[last].end(), archive.getData(*entry));
+    }
+    fs::remove_all(dir);
+
+    std::cout << ARCHIVE_TEXTURES << " textures of " << ARCHIVE_RESOLUTION << "x"
+        << ARCHIVE_RESOLUTION << std::endl;
+    const Table table({Column("output", 10), Column("write [s]", 12), Column("read [s]", 12)});
+    table.row("files", files_write, files_read);
+    table.row("archive", archive_write, archive_read);
+
+    if (!ok)
+        std::cout << "[ERROR] Archived textures differ from the ones written, or a cut"
+            " archive was not recovered" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkTables(const Options & options)
+{
+    PatternGeneration pattern_generation(options.seed);
+    cv::Mat texture(TABLE_RESOLUTION, TABLE_RESOLUTION, CV_8UC3);
+    const RenderTarget target(texture);
+    const int counts[] = {0, PatternGeneration::DEFAULT_PERLIN_TABLES};
+    double setups[2];
+
+    // Tiny textures, so that setting up the noise is a large part of the
+    // time. The setup alone is picking or shuffling the permutation vector,
+    // and the seed time what a generator pays before its first texture
+    std::cout << TABLE_TEXTURES << " textures of " << TABLE_RESOLUTION << "x"
+        << TABLE_RESOLUTION << std::endl;
+    const Table table({Column("tables", 10), Column("perlin [us]", 14),
+        Column("fractal [us]", 14), Column("setup [us]", 14), Column("seed [us]", 14)});
+    for (int c = 0; c < 2; ++c) {
+        pattern_generation.setPerlinTableCount(counts[c]);
+        double perlin = bestTime(options.repetitions, [&]{
+            for (int k = 0; k < TABLE_TEXTURES; ++k) {
+                RandomEngine rng = pattern_generation.getRandomEngine(k, 3);
+                pattern_generation.getPerlinNoiseTexture(rng, target, false);
+            }
+        });
+        double fractal = bestTime(options.repetitions, [&]{
+            for (int k = 0; k < TABLE_TEXTURES; ++k) {
+                RandomEngine rng = pattern_generation.getRandomEngine(k, 4);
+                pattern_generation.getFractalNoiseTexture(rng, target, FractalNoise::FBM, 1);
+            }
+        });
+        TextureSpec spec(TextureSpec::PERLIN, texture.size());
+        setups[c] = bestTime(options.repetitions, [&]{
+            for (int k = 0; k < TABLE_TEXTURES; ++k) {
+                spec.rng = pattern_generation.getRandomEngine(k, 3);
+                pattern_generation.getProceduralTexture(spec);
+            }
+        });
+        double seed = bestTime(options.repetitions, [&]{
+            pattern_generation.setSeed(options.seed);
+        });
+        table.row(counts[c], perlin / TABLE_TEXTURES * 1e6, fractal / TABLE_TEXTURES * 1e6,
+            setups[c] / TABLE_TEXTURES * 1e6, seed * 1e6);
+    }
+
+    // Picking a table has to beat shuffling one, or the pool is not worth it
+    if (setups[1] >= setups[0]) {
+        std::cout << "[ERROR] Picking a pooled permutation table is no faster than"
+            " shuffling one" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////
+void referenceGradient(const cv::Scalar & color1, const cv::Scalar & color2,
+    const bool & vertical, cv::Mat & texture)
+{
+    // The generic gradient loop the specialized kernels replaced, checking
+    // the orientation on every pixel
+    const int steps = vertical ? texture.rows : texture.cols;
+    const cv::Scalar gradient_step(color1 - color2);
+    std::vector<cv::Vec3b> colors(steps);
+    for (int k = 0; k < steps; ++k)
+        for (int c = 0; c < 3; ++c)
+            reinterpret_cast<uchar *>(&colors[k])[c] = color1[c] - k * gradient_step[c] / steps;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < texture.rows; ++i) {
+        cv::Vec3b * row = texture.ptr<cv::Vec3b>(i);
+        for (int j = 0; j < texture.cols; ++j)
+            row[j] = vertical ? colors[i] : colors[j];
+    }
+}
+
+//////////////////////////////////////////////////
+void referencePerlin(const PerlinNoise & pn, const RandomEngine & pixel_rng,
+    const PatternGeneration::Precision & precision, const bool & random_colors,
+    const double z[3], const double & frequency, cv::Mat & texture)
+{
+    // The generic Perlin loop the specialized kernels replaced, switching on
+    // the precision every row and checking the color mode every row and
+    // channel, without the color conversion
+    const int width = texture.cols, n = width;
+    #pragma omp parallel
+    {
+        std::vector<double> xd(n), zd[3], nd[3];
+        std::vector<float> xs(n), zs[3], ns[3];
+        for (int c = 0; c < 3; ++c) {
+            zd[c].resize(n);
+            nd[c].resize(n);
+            zs[c].resize(n);
+            ns[c].resize(n);
+        }
+        for (int j = 0; j < n; ++j) {
+            xs[j] = (float)(frequency * j)/((float)width);
+            xd[j] = (frequency * j)/((double)width);
+        }
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < texture.rows; ++i) {
+            uchar * row = texture.ptr<uchar>(i);
+            const uint64_t row_counter = (uint64_t) i * width * 3;
+
+            switch (precision) {
+            case PatternGeneration::PRECISION_FLOAT: {
+                float y = (float)(frequency * i)/((float)width);
+                if (random_colors) {
+                    for (int j = 0; j < n; ++j)
+                        for (int c = 0; c < 3; ++c)
+                            zs[c][j] = (float) pixel_rng.uniformRealAt(row_counter + j * 3 + c);
+                }
+                for (int c = 0; c < 3; ++c) {
+                    if (random_colors)
+                        pn.noiseRow(xs.data(), y, zs[c].data(), ns[c].data(), n);
+                    else
+                        pn.noiseRow(xs.data(), y, (float) z[c], ns[c].data(), n);
+                }
+                for (int j = 0; j < n; ++j)
+                    for (int c = 0; c < 3; ++c) {
+                        float val = 20.0f * ns[c][j];
+                        val = val - std::floor(val);
+                        row[j * 3 + c] = (uchar) (255.0f * val);
+                    }
+                break;
+            }
+
+            case PatternGeneration::PRECISION_FIXED:
+                for (int j = 0; j < n; ++j) {
+                    int32_t x = (int32_t) ((((int64_t) j << 16) * frequency) / width);
+                    int32_t y = (int32_t) ((((int64_t) i << 16) * frequency) / width);
+                    int32_t zf[3], nf[3];
+                    for (int c = 0; c < 3; ++c) {
+                        double zc = random_colors ?
+                            pixel_rng.uniformRealAt(row_counter + j * 3 + c) : z[c];
+                        zf[c] = (int32_t) lrint(zc * 65536);
+                    }
+                    pn.noiseFixed(x, y, zf, nf, 3);
+                    for (int c = 0; c < 3; ++c)
+                        row[j * 3 + c] = (uchar) ((((20 * nf[c]) & 0xFFFF) * 255) >> 16);
+                }
+                break;
+
+            default: {
+                double y = (frequency * i)/((double)width);
+                if (random_colors) {
+                    for (int j = 0; j < n; ++j)
+                        for (int c = 0; c < 3; ++c)
+                            zd[c][j] = pixel_rng.uniformRealAt(row_counter + j * 3 + c);
+                }
+                for (int c = 0; c < 3; ++c) {
+                    if (random_colors)
+                        pn.noiseRow(xd.data(), y, zd[c].data(), nd[c].data(), n);
+                    else
+                        pn.noiseRow(xd.data(), y, z[c], nd[c].data(), n);
+                }
+                for (int j = 0; j < n; ++j)
+                    for (int c = 0; c < 3; ++c) {
+                        double val = 20.0 * nd[c][j];
+                        val = val - floor(val);
+                        row[j * 3 + c] = (uchar) floor(255 * val);
+                    }
+            }
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////
+int benchmarkKernels(const Options & options)
+{
+    const char * precisions[] = {"double", "float", "fixed"};
+    const int size = options.resolution;
+    const double pixels = (double) size * size;
+    PatternGeneration pattern_generation(options.seed);
+    // The references skip the color conversion, and draw their permutation
+    // vector and pixel stream from the texture engine as the generator does
+    // without a table pool
+    pattern_generation.setColorSpace(PatternGeneration::COLOR_SPACE_LAB);
+    pattern_generation.setPerlinTableCount(0);
+    const int threads = maxThreads(options);
+    setThreads(threads);
+    cv::Mat texture(size, size, CV_8UC3), reference(size, size, CV_8UC3);
+    const RenderTarget target(texture);
+    RandomEngine rng = pattern_generation.getRandomEngine(0, 0);
+    cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+    cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+    bool ok = true;
+
+    // One line per kernel instantiation, as picked by the generator
+    // arguments, against the runtime branching loop it replaced
+    std::cout << size << "x" << size << ", " << threads << " threads" << std::endl;
+    const Table table({Column("kernel", 24), Column("reference [s]", 15, 6),
+        Column("specialized [s]", 17, 6), Column("Mpixels/s", 12), Column("speedup", 10, 2, "x"),
+        Column("equal", 7)});
+    auto report = [&](const std::string & name, double reference_time, double time) {
+        const bool equal = samePixels(texture, reference);
+        ok = ok && equal;
+        table.row(name, reference_time, time, pixels / time * 1e-6, reference_time / time,
+            equal ? "yes" : "no");
+    };
+
+    for (int vertical = 0; vertical < 2; ++vertical) {
+        double reference_time = bestTime(options.repetitions, [&]{
+            referenceGradient(color1, color2, vertical, reference);
+        });
+        double time = bestTime(options.repetitions, [&]{
+            pattern_generation.getGradientTexture(color1, color2, target, vertical);
+        });
+        report(vertical ? "gradient vertical" : "gradient horizontal", reference_time, time);
+    }
+    const double z[3] = {0.8, 0.8, 0.8};
+    for (int precision = PatternGeneration::PRECISION_DOUBLE;
+        precision <= PatternGeneration::PRECISION_FIXED; ++precision) {
+        pattern_generation.setPrecision((PatternGeneration::Precision) precision);
+        for (int random_colors = 0; random_colors < 2; ++random_colors) {
+            double reference_time = bestTime(options.repetitions, [&]{
+                RandomEngine rng = pattern_generation.getRandomEngine(0, 3);
+                const PerlinNoise pn(rng);
+                const RandomEngine pixel_rng(rng());
+                referencePerlin(pn, pixel_rng, (PatternGeneration::Precision) precision,
+                    random_colors, z, 1.0, reference);
+            });
+            double time = bestTime(options.repetitions, [&]{
+                RandomEngine rng = pattern_generation.getRandomEngine(0, 3);
+                pattern_generation.getPerlinNoiseTexture(rng, target, random_colors,
+                    z[0], z[1], z[2], 1.0);
+            });
+            report(std::string("perlin ") + precisions[precision] +
+                (random_colors ? " random" : " fixed"), reference_time, time);
+        }
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Specialized kernels differ from the reference loops" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkFill(const Options & options)
+{
+    const int size = options.resolution;
+    const double bytes = 3.0 * size * size;
+    PatternGeneration pattern_generation(options.seed);
+    cv::Mat texture(size, size, CV_8UC3);
+    const RenderTarget target(texture);
+    RandomEngine rng = pattern_generation.getRandomEngine(0, 0);
+    cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+    cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+    const int threads = maxThreads(options);
+    setThreads(threads);
+
+    // memset of the whole image from one thread, and of one row range per
+    // thread, which the fills are checked against
+    double memset_time = bestTime(options.repetitions, [&]{
+        std::memset(texture.data, 0, bytes);
+    });
+    double parallel_memset_time = bestTime(options.repetitions, [&]{
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < size; ++i)
+            std::memset(texture.ptr<uchar>(i), 0, size * 3);
+    });
+    double flat_time = bestTime(options.repetitions, [&]{
+        pattern_generation.getFlatTexture(color1, target);
+    });
+    double chess_time = bestTime(options.repetitions, [&]{
+        pattern_generation.getChessTexture(color1, color2, size / 8 + 1, target);
+    });
+
+    std::cout << size << "x" << size << ", image of " << bytes / (1 << 20) << " MB, " << threads
+        << " threads" << std::endl;
+    const Table table({Column("fill", 16), Column("time [s]", 12), Column("GB/s", 12),
+        Column("of memset", 12, 3, "%")});
+    const char * names[] = {"memset", "memset parallel", "flat", "chess"};
+    const double times[] = {memset_time, parallel_memset_time, flat_time, chess_time};
+    for (int k = 0; k < 4; ++k)
+        table.row(names[k], times[k], bytes / times[k] * 1e-9,
+            100 * parallel_memset_time / times[k]);
+
+    const double slowest = std::max(flat_time, chess_time);
+    if (bytes >= FILL_MIN_BYTES && parallel_memset_time < FILL_MIN_FRACTION * slowest) {
+        std::cout << "[ERROR] Flat or chess fill below " << 100 * FILL_MIN_FRACTION
+            << "% of the parallel memset bandwidth" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////
+int benchmarkBatch(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient", "perlin", "fractal"};
+    PatternGeneration pattern_generation(options.seed);
+    const cv::Size size(BATCH_RESOLUTION, BATCH_RESOLUTION);
+    setThreads(maxThreads(options));
+
+    // Every pattern in turn, with the parameters of texture k
+    std::vector<TextureSpec> specs;
+    for (int k = 0; k < BATCH_TEXTURES; ++k) {
+        TextureSpec spec((TextureSpec::Pattern) (k % 5), size);
+        RandomEngine rng = pattern_generation.getRandomEngine(k, k % 5);
+        spec.color1 = pattern_generation.getRandomColor(rng);
+        spec.color2 = pattern_generation.getRandomColor(rng);
+        spec.block_size = BATCH_RESOLUTION / 8 + 1;
+        spec.vertical = k % 2;
+        spec.random_colors = k % 2;
+        spec.rng = rng;
+        specs.push_back(spec);
+    }
+
+    std::vector<cv::Mat> single(specs.size()), batch;
+    for (size_t k = 0; k < specs.size(); ++k)
+        single[k].create(size, CV_8UC3);
+    double single_time = bestTime(options.repetitions, [&]{
+        for (size_t k = 0; k < specs.size(); ++k) {
+            const TextureSpec & spec = specs[k];
+            RandomEngine rng = spec.rng;
+            const RenderTarget target(single[k]);
+            switch (spec.pattern) {
+            case TextureSpec::FLAT: pattern_generation.getFlatTexture(spec.color1, target); break;
+            case TextureSpec::CHESS: pattern_generation.getChessTexture(spec.color1, spec.color2,
+                spec.block_size, target); break;
+            case TextureSpec::GRADIENT: pattern_generation.getGradientTexture(spec.color1,
+                spec.color2, target, spec.vertical); break;
+            case TextureSpec::PERLIN: pattern_generation.getPerlinNoiseTexture(rng, target,
+                spec.random_colors); break;
+            default: pattern_generation.getFractalNoiseTexture(rng, target); break;
+            }
+        }
+    });
+    double batch_time = bestTime(options.repetitions, [&]{
+        pattern_generation.generateBatch(specs, batch);
+    });
+
+    bool ok = batch.size() == single.size();
+    for (size_t k = 0; k < single.size() && ok; ++k)
+        for (int i = 0; i < size.height && ok; ++i)
+            ok = std::equal(single[k].ptr<uchar>(i), single[k].ptr<uchar>(i) + size.width * 3,
+                batch[k].ptr<uchar>(i));
+
+    std::cout << BATCH_TEXTURES << " textures of " << BATCH_RESOLUTION << "x" << BATCH_RESOLUTION
+        << ", " << names[0];
+    for (int t = 1; t < 5; ++t)
+        std::cout << ", " << names[t];
+    std::cout << " in turn, " << maxThreads(options) << " threads" << std::endl;
+    const Table table({Column("mode", 10), Column("time [s]", 12), Column("textures/s", 14)});
+    table.row("single", single_time, BATCH_TEXTURES / single_time);
+    table.row("batch", batch_time, BATCH_TEXTURES / batch_time);
+
+    if (!ok)
+        std::cout << "[ERROR] Batched textures differ from the ones drawn one by one" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkRegions(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient", "perlin", "fractal"};
+    const int size = options.resolution;
+    const int half = std::max(1, size / 2);
+    const int side = std::min(REGION_SIZE, half);
+    PatternGeneration pattern_generation(options.seed);
+    RandomEngine sampler(options.seed);
+    setThreads(maxThreads(options));
+    bool ok = true;
+
+    std::cout << size << "x" << size << " textures, " << side << "x" << side << " regions, "
+        << maxThreads(options) << " threads" << std::endl;
+    const Table table({Column("pattern", 10), Column("whole [s]", 12, 6),
+        Column("region [s]", 12, 6), Column("speedup", 10, 1)});
+    for (int p = 0; p < 5; ++p) {
+        TextureSpec spec((TextureSpec::Pattern) p, cv::Size(size, size));
+        RandomEngine rng = pattern_generation.getRandomEngine(p, p);
+        spec.color1 = pattern_generation.getRandomColor(rng);
+        spec.color2 = pattern_generation.getRandomColor(rng);
+        spec.block_size = size / 8 + 1;
+        spec.rng = rng;
+        const ProceduralTexture texture = pattern_generation.getProceduralTexture(spec);
+
+        // The whole texture as generated, at its size and at half size
+        std::vector<TextureSpec> specs(2, spec);
+        specs[1].size = cv::Size(half, half);
+        std::vector<cv::Mat> wholes;
+        pattern_generation.generateBatch(specs, wholes);
+
+        cv::Mat pixels;
+        for (int k = 0; k < REGION_SAMPLES; ++k) {
+            const cv::Rect region(sampler.uniform(size - side + 1), sampler.uniform(size - side + 1),
+                side, side);
+            texture.render(region, pixels);
+            ok = ok && samePixels(pixels, wholes[0](region));
+
+            // Chess squares scale with the image, every other pattern is
+            // generated anew at the smaller size
+            const cv::Rect scaled(sampler.uniform(half - side + 1), sampler.uniform(half - side + 1),
+                side, side);
+            texture.render(scaled, pixels, cv::Size(half, half));
+            if (spec.pattern != TextureSpec::CHESS) {
+                ok = ok && samePixels(pixels, wholes[1](scaled));
+                continue;
+            }
+            for (int i = 0; i < side && ok; ++i)
+                for (int j = 0; j < side && ok; ++j)
+                    ok = pixels.at<cv::Vec3b>(i, j) == wholes[0].at<cv::Vec3b>(
+                        (scaled.y + i) * size / half, (scaled.x + j) * size / half);
+        }
+
+        double whole_time = bestTime(options.repetitions, [&]{
+            texture.render(cv::Rect(0, 0, size, size), pixels);
+        });
+        double region_time = bestTime(options.repetitions, [&]{
+            texture.render(cv::Rect(size - side, size - side, side, side), pixels);
+        });
+        table.row(names[p], whole_time, region_time, whole_time / region_time);
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Regions differ from the whole textures" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+cv::Mat boxAverage(const cv::Mat & texture, const cv::Size & size)
+{
+    // Every pixel averages the texture pixels [x * W / w, (x + 1) * W / w)
+    // and likewise for rows, as the mip levels are defined
+    cv::Mat level(size, CV_8UC3);
+    for (int y = 0; y < size.height; ++y)
+        for (int x = 0; x < size.width; ++x) {
+            const int y0 = (int) ((int64_t) y * texture.rows / size.height);
+            const int y1 = (int) ((int64_t) (y + 1) * texture.rows / size.height);
+            const int x0 = (int) ((int64_t) x * texture.cols / size.width);
+            const int x1 = (int) ((int64_t) (x + 1) * texture.cols / size.width);
+            int64_t sum[3] = {0, 0, 0};
+            for (int i = y0; i < y1; ++i)
+                for (int j = x0; j < x1; ++j)
+                    for (int c = 0; c < 3; ++c)
+                        sum[c] += texture.at<cv::Vec3b>(i, j)[c];
+            const int64_t count = (int64_t) (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 3; ++c)
+                level.at<cv::Vec3b>(y, x)[c] = (uchar) ((sum[c] + count / 2) / count);
+        }
+    return level;
+}
+
+//////////////////////////////////////////////////
+int benchmarkMipmaps(const Options & options)
+{
+    // Perlin twice, with random and with fixed colors
+    const char * names[] = {"flat", "chess", "gradient", "perlin", "fractal", "perlin fixed"};
+    const int size = options.resolution;
+    PatternGeneration pattern_generation(options.seed);
+    setThreads(maxThreads(options));
+    bool ok = true;
+
+    std::cout << size << "x" << size << " mip chains, " << maxThreads(options) << " threads"
+        << std::endl;
+    const Table table({Column("pattern", 13), Column("definition [s]", 15, 6),
+        Column("downsample [s]", 15, 6), Column("max diff", 12)});
+    for (int p = 0; p < 6; ++p) {
+        TextureSpec spec(p < 5 ? (TextureSpec::Pattern) p : TextureSpec::PERLIN,
+            cv::Size(size, size));
+        spec.random_colors = p < 5;
+        RandomEngine rng = pattern_generation.getRandomEngine(p, p);
+        spec.color1 = pattern_generation.getRandomColor(rng);
+        spec.color2 = pattern_generation.getRandomColor(rng);
+        spec.block_size = size / 8 + 1;
+        spec.rng = rng;
+        const ProceduralTexture texture = pattern_generation.getProceduralTexture(spec);
+
+        std::vector<cv::Mat> levels, downsampled(texture.getMipLevels());
+        double definition_time = bestTime(options.repetitions, [&]{
+            texture.renderMipmaps(levels);
+        });
+        double downsample_time = bestTime(options.repetitions, [&]{
+            texture.render(cv::Rect(0, 0, size, size), downsampled[0]);
+            for (size_t k = 1; k < downsampled.size(); ++k)
+                cv::resize(downsampled[k - 1], downsampled[k], texture.getMipSize(k), 0, 0,
+                    cv::INTER_AREA);
+        });
+
+        // Flat, gradient and chess levels are exact, the noise ones are
+        // only reported. The texture samples wood rings at single points,
+        // so its box average is off by up to half the ring ramp at their
+        // edges
+        int difference = 0;
+        for (size_t k = 1; k < levels.size(); ++k)
+            difference = std::max(difference,
+                maxDifference(levels[k], boxAverage(levels[0], levels[k].size())));
+        if (p < TextureSpec::PERLIN)
+            ok = ok && difference <= MIPMAP_TOLERANCE;
+
+        std::vector<uchar> dds;
+        size_t data_size = 0;
+        for (size_t k = 0; k < levels.size(); ++k)
+            data_size += levels[k].total() * 3;
+        ok = ok && encodeDds(levels, dds) && dds.size() == 128 + data_size;
+
+        table.row(names[p], definition_time, downsample_time, difference);
+    }
+
+    if (!ok)
+        std::cout << "[ERROR] Mip levels differ from the box filtered textures, or their DDS "
+            "file has the wrong size" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkService(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient", "perlin", "fractal"};
+    const int size = options.resolution;
+    const std::string socket_path = "/tmp/pattern_generation_benchmark_" +
+        std::to_string(getpid()) + ".sock";
+    PatternGeneration pattern_generation(options.seed);
+    setThreads(maxThreads(options));
+
+    TextureServer server(pattern_generation, socket_path,
+        "pattern_generation_benchmark_" + std::to_string(getpid()), SERVICE_SLOTS,
+        (std::size_t) size * size * 3, maxThreads(options));
+    TextureClient client;
+    if (!server.start()) {
+        std::cout << "[ERROR] Could not start the server on " << socket_path << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::thread serving([&]{ server.run(); });
+    bool ok = client.open(socket_path);
+
+    std::cout << size << "x" << size << " textures, " << SERVICE_SLOTS << " slots, "
+        << maxThreads(options) << " threads" << std::endl;
+    const Table table({Column("pattern", 10), Column("local [s]", 12, 6),
+        Column("service [s]", 12, 6), Column("overhead [s]", 14, 6)});
+    for (int p = 0; p < 5 && ok; ++p) {
+        TextureSpec spec((TextureSpec::Pattern) p, cv::Size(size, size));
+        RandomEngine rng = pattern_generation.getRandomEngine(p, p);
+        spec.color1 = pattern_generation.getRandomColor(rng);
+        spec.color2 = pattern_generation.getRandomColor(rng);
+        spec.block_size = size / 8 + 1;
+        const TextureService::Request request = TextureService::makeRequest(spec, p, p);
+
+        // The same texture drawn in process, from the same random stream
+        spec.rng = pattern_generation.getRandomEngine(p, p);
+        const ProceduralTexture texture = pattern_generation.getProceduralTexture(spec);
+        cv::Mat local;
+        double local_time = bestTime(options.repetitions, [&]{
+            texture.render(cv::Rect(0, 0, size, size), local);
+        });
+
+        TextureService::Reply reply;
+        ok = client.request(request, reply) && reply.status == TextureService::OK &&
+            samePixels(client.getPixels(reply), local) && client.release(reply);
+        double service_time = bestTime(options.repetitions, [&]{
+            ok = ok && client.request(request, reply) && reply.status == TextureService::OK &&
+                client.release(reply);
+        });
+        table.row(names[p], local_time, service_time, service_time - local_time);
+    }
+
+    // Slots are held until released: one request more than the ring holds
+    // is refused, and so is a texture larger than a slot
+    std::vector<TextureService::Reply> held(SERVICE_SLOTS + 1);
+    const TextureService::Request flat = TextureService::makeRequest(
+        TextureSpec(TextureSpec::FLAT, cv::Size(size, size)), 0, 0);
+    for (int k = 0; k <= SERVICE_SLOTS && ok; ++k)
+        ok = client.request(flat, held[k]) &&
+            held[k].status == (k < SERVICE_SLOTS ? TextureService::OK : TextureService::RING_FULL);
+    for (int k = 0; k < SERVICE_SLOTS && ok; ++k)
+        ok = client.release(held[k]);
+    const TextureService::Request large = TextureService::makeRequest(
+        TextureSpec(TextureSpec::FLAT, cv::Size(size + 1, size)), 0, 0);
+    ok = ok && client.request(large, held[0]) && held[0].status == TextureService::TOO_LARGE;
+
+    client.close();
+    server.stop();
+    serving.join();
+    if (!ok)
+        std::cout << "[ERROR] Served textures differ from the ones drawn in process, or the "
+            "ring did not refuse requests beyond its slots" << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int benchmarkSuite(const Options & options)
+{
+    const char * names[] = {"flat", "chess", "gradient_h", "gradient_v", "perlin",
+        "perlin_random", "fractal"};
+    const int types = sizeof(names) / sizeof(names[0]);
+    PatternGeneration pattern_generation(options.seed);
+    std::vector<SuiteResult> results;
+
+    std::vector<int> resolutions;
+    for (int size = SUITE_MIN_RESOLUTION; size < options.resolution; size *= 2)
+        resolutions.push_back(size);
+    resolutions.push_back(options.resolution);
+    std::vector<int> counts;
+    for (int threads = 1; threads < maxThreads(options); threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(maxThreads(options));
+
+    // Times a case once warmed up, then counts the allocations of one more
+    // iteration
+    const Table table({Column("case", 40), Column("time [ms]", 12), Column("Mpixels/s", 14),
+        Column("GB/s", 12), Column("allocs", 10, 0)});
+    auto measure = [&](const std::string & name, int resolution, int threads, double pixels,
+        std::function<void()> function) {
+        function();
+        SuiteResult r;
+        r.name = name;
+        r.resolution = resolution;
+        r.threads = threads;
+        r.time = bestTime(options.repetitions, function);
+        allocations = 0;
+        function();
+        r.allocations = (double) allocations;
+        r.pixels_per_second = pixels / r.time;
+        r.bytes_per_second = resolution ? 3 * pixels / r.time : 0;
+        results.push_back(r);
+
+        table.row(suiteKey(name, resolution, threads), r.time * 1e3, r.pixels_per_second * 1e-6,
+            r.bytes_per_second * 1e-9, r.allocations);
+    };
+
+    // Point noise, single threaded
+    {
+        RandomEngine rng(options.seed);
+        PerlinNoise pn(rng);
+        volatile double result = 0;
+        measure("perlin_noise", 0, 1, SUITE_NOISE_SAMPLES, [&]{
+            double sum = 0;
+            for (int k = 0; k < SUITE_NOISE_SAMPLES; ++k)
+                sum += pn.noise(k * 0.001, k * 0.0007, 0.5);
+            result = sum;
+        });
+    }
+
+    // Every generator into a reused image
+    for (const int & size : resolutions) {
+        cv::Mat texture(size, size, CV_8UC3);
+        const RenderTarget target(texture);
+        for (const int & threads : counts) {
+            setThreads(threads);
+            for (int t = 0; t < types; ++t) {
+                measure(names[t], size, threads, (double) size * size, [&]{
+                    RandomEngine rng = pattern_generation.getRandomEngine(0, t);
+                    cv::Scalar color1 = pattern_generation.getRandomColor(rng);
+                    cv::Scalar color2 = pattern_generation.getRandomColor(rng);
+                    switch (t) {
+                    case 0: pattern_generation.getFlatTexture(color1, target); break;
+                    case 1: pattern_generation.getChessTexture(color1, color2, size / 8 + 1, target); break;
+                    case 2: pattern_generation.getGradientTexture(color1, color2, target, false); break;
+                    case 3: pattern_generation.getGradientTexture(color1, color2, target, true); break;
+                    case 4: pattern_generation.getPerlinNoiseTexture(rng, target, false); break;
+                    case 5: pattern_generation.getPerlinNoiseTexture(rng, target, true); break;
+                    default: pattern_generation.getFractalNoiseTexture(rng, target); break;
+                    }
+                });
+            }
+        }
+    }
+
+    // Whole pipeline, a Perlin texture drawn, encoded and written
+    namespace fs = boost::filesystem;
+    const fs::path file = fs::temp_directory_path() /
+        fs::unique_path("pattern_generation_%%%%%%%%.png");
+    std::vector<uchar> encoded;
+    for (const int & size : resolutions) {
+        cv::Mat texture(size, size, CV_8UC3);
+        const RenderTarget target(texture);
+        const int threads = counts.back();
+        setThreads(threads);
+        measure("pipeline_png", size, threads, (double) size * size, [&]{
+            RandomEngine rng = pattern_generation.getRandomEngine(0, 4);
+            pattern_generation.getPerlinNoiseTexture(rng, target, false);
+            cv::imencode(".png", texture, encoded);
+            std::ofstream ofs(file.string(), std::ios::binary);
+            ofs.write(reinterpret_cast<const char *>(encoded.data()), encoded.size());
+        });
+    }
+    fs::remove(file);
+
+    if (!options.output.empty() && !writeSuite(options.output, options, results)) {
+        std::cout << "[ERROR] Could not write " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.baseline.empty())
+        return EXIT_SUCCESS;
+
+    // Cases missing from the baseline are new, not regressions
+    std::map<std::string, double> times;
+    if (!readSuite(options.baseline, times))
+        return EXIT_FAILURE;
+
+    bool ok = true;
+    for (const SuiteResult & r : results) {
+        const std::string key = suiteKey(r.name, r.resolution, r.threads);
+        auto it = times.find(key);
+        if (it == times.end() || it->second <= 0)
+            continue;
+        double change = r.time / it->second - 1;
+        if (change > SUITE_REGRESSION_TOLERANCE) {
+            std::cout << "[ERROR] " << key << " is " << std::fixed << std::setprecision(1)
+                << 100 * change << "% slower than the baseline" << std::endl;
+            ok = false;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cout << getUsage(argv[0]) << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string mode = argv[1];
+
+    Options options;
+    options.resolution = ARG_IMG_RESOLUTION_DEFAULT;
+    options.repetitions = ARG_REPETITIONS_DEFAULT;
+    options.threads = 0;
+    options.seed = ARG_SEED_DEFAULT;
+
+    int opt;
+    optind = 2;
+    while ( (opt = getopt(argc,argv,"r: n: j: S: o: b:")) != EOF)
+    {
+        switch (opt)
+        {
+            case 'r':
+                options.resolution = atoi(optarg); break;
+            case 'n':
+                options.repetitions = std::max(1, atoi(optarg)); break;
+            case 'j':
+                options.threads = atoi(optarg); break;
+            case 'S':
+                options.seed = strtoull(optarg, NULL, 10); break;
+            case 'o':
+                options.output = optarg; break;
+            case 'b':
+                options.baseline = optarg; break;
+            default:
+                std::cout << getUsage(argv[0]) << std::endl;
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (mode == "scaling")
+        return benchmarkScaling(options);
+    if (mode == "simd")
+        return benchmarkSimd(options);
+    if (mode == "precision")
+        return benchmarkPrecision(options);
+    if (mode == "octaves")
+        return benchmarkOctaves(options);
+    if (mode == "allocs")
+        return benchmarkAllocations(options);
+    if (mode == "tiles")
+        return benchmarkTiles(options);
+    if (mode == "stream")
+        return benchmarkStream(options);
+    if (mode == "archive")
+        return benchmarkArchive(options);
+    if (mode == "tables")
+        return benchmarkTables(options);
+    if (mode == "kernels")
+        return benchmarkKernels(options);
+    if (mode == "fill")
+        return benchmarkFill(options);
+    if (mode == "batch")
+        return benchmarkBatch(options);
+    if (mode == "regions")
+        return benchmarkRegions(options);
+    if (mode == "mipmaps")
+        return benchmarkMipmaps(options);
+    if (mode == "service")
+        return benchmarkService(options);
+    if (mode == "suite")
+        return benchmarkSuite(options);
+
+    std::cout << getUsage(argv[0]) << std::endl;
+    return EXIT_FAILURE;
+}
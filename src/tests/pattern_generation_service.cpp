@@ -0,0 +1,153 @@
+/*
+ *  Copyright (C) 2018 João Borrego and Rui Figueiredo
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*!
+
+    \brief Resident texture generator, serving raw pixels through shared memory
+
+    \author Rui Figueiredo : ruipimentelfigueiredo
+    \author João Borrego   : jsbruglie
+
+*/
+
+#include "pattern_generation/PatternGeneration.h"
+#include "pattern_generation/TextureService.h"
+
+// C libraries
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// C++ libraries
+#include <iostream>
+#include <string>
+#include <thread>
+
+/// Default socket file
+#define ARG_SOCKET_DEFAULT          "/tmp/pattern_generation.sock"
+/// Default number of ring slots
+#define ARG_SLOTS_DEFAULT           8
+/// Default largest image resolution, which sizes the slots
+#define ARG_IMG_RESOLUTION_DEFAULT  2048
+/// Default Perlin noise precision
+#define ARG_PRECISION_DEFAULT       "double"
+/// Shared memory ring name prefix, followed by the process id
+#define RING_PREFIX                 "pattern_generation_"
+
+//////////////////////////////////////////////////
+const std::string getUsage(const char* argv_0)
+{
+    return \
+        "usage:   " + std::string(argv_0) + " [options]\n" +
+        "options: -u <socket file>\n" +
+        "         -n <number of ring slots, textures clients may hold at once>\n" +
+        "         -r <largest image resolution>\n" +
+        "         -j <render threads>\n" +
+        "         -S <random seed>\n" +
+        "         -p <perlin noise precision: double, float or fixed>\n";
+}
+
+//////////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+    std::string socket_path {ARG_SOCKET_DEFAULT};
+    unsigned int slots {ARG_SLOTS_DEFAULT};
+    unsigned int resolution {ARG_IMG_RESOLUTION_DEFAULT};
+    unsigned int threads {0};
+    bool seeded {false};
+    uint64_t seed {0};
+    std::string precision {ARG_PRECISION_DEFAULT};
+
+    int opt;
+    while ((opt = getopt(argc, argv, "u: n: r: j: S: p:")) != EOF)
+    {
+        switch (opt)
+        {
+            case 'u':
+                socket_path = optarg; break;
+            case 'n':
+                slots = atoi(optarg); break;
+            case 'r':
+                resolution = atoi(optarg); break;
+            case 'j':
+                threads = atoi(optarg); break;
+            case 'S':
+                seeded = true; seed = strtoull(optarg, NULL, 10); break;
+            case 'p':
+                precision = optarg; break;
+            default:
+                std::cout << getUsage(argv[0]) << std::endl;
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (slots == 0 || resolution == 0)
+    {
+        std::cerr << "The ring needs at least one slot of one pixel! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // SIGINT and SIGTERM are taken by a thread of their own, which stops
+    // the server so that the socket file and the ring are removed. Blocked
+    // before any other thread, OpenMP ones included, is started
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    /* Pattern generator, kept with its permutation tables for every request */
+    PatternGeneration pattern_generation;
+    if (seeded)
+        pattern_generation.setSeed(seed);
+    std::cout << "Using seed " << pattern_generation.getSeed() << std::endl;
+
+    if (precision == "double")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_DOUBLE);
+    else if (precision == "float")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_FLOAT);
+    else if (precision == "fixed")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_FIXED);
+    else
+    {
+        std::cerr << "Unknown precision " << precision << "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const std::string ring_name = RING_PREFIX + std::to_string(getpid());
+    const std::size_t slot_size = (std::size_t) resolution * resolution * 3;
+    TextureServer server(pattern_generation, socket_path, ring_name, slots, slot_size, threads);
+    if (!server.start())
+    {
+        std::cerr << "Could not create " << socket_path << " or the shared memory ring " <<
+            ring_name << "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Serving on " << socket_path << ", " << slots << " slots of up to " <<
+        resolution << "x" << resolution << " in " << ring_name << std::endl;
+
+    std::thread signal_thread([&]{
+        int signal;
+        sigwait(&signals, &signal);
+        server.stop();
+    });
+    server.run();
+
+    // Stopped from elsewhere than a signal, the signal thread still waits
+    pthread_kill(signal_thread.native_handle(), SIGTERM);
+    signal_thread.join();
+    std::cout << "Stopped" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -24,11 +24,20 @@
 */
 
 #include "pattern_generation/PatternGeneration.h"
+#include "pattern_generation/BoundedQueue.h"
+#include "pattern_generation/DdsWriter.h"
+#include "pattern_generation/Instrumentation.h"
+#include "pattern_generation/PpmWriter.h"
+#include "pattern_generation/TextureArchive.h"
+#include "pattern_generation/TextureCache.h"
 
 // C libraries
 #include <ctype.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <boost/filesystem.hpp>
 
@@ -40,18 +49,33 @@
 #include <sstream>
 #include <iomanip>
 #include <string>
+// Threading
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 // File system
 #include <boost/filesystem.hpp>
 
 
-/// Default image file extension
-#define IMG_EXT         ".jpg"
 /// Material name prefix
 #define MATERIAL_PREFIX "Plugin/"
 /// Material name extension
 #define MATERIAL_EXT    ".material"
 /// Texture path prefix
 #define TEXTURE_PREFIX  "Plugin/"
+/// Archive file name, in the textures directory
+#define ARCHIVE_NAME    "textures.pga"
+/// Consolidated material script name of archives, in the scripts directory
+#define ARCHIVE_MATERIALS "textures.material"
+/// Manifest of the textures a shard completed, in the output directory
+#define MANIFEST_FORMAT "manifest_%u_of_%u.txt"
 
 /// Show image GUI
 #define SHOW_IMGS       false
@@ -70,45 +94,68 @@
 #define ARG_OUTPUT_DIR_DEFAULT     "output/"
 /// Default image file extension
 #define ARG_TYPE_DEFAULT            "all"
+/// Default number of worker threads per pipeline stage
+#define ARG_JOBS_DEFAULT            1
+/// Default Perlin noise precision
+#define ARG_PRECISION_DEFAULT       "double"
+/// Default image format
+#define ARG_FORMAT_DEFAULT          "jpg"
+/// Default texture cache size limit, in MB
+#define ARG_CACHE_SIZE_DEFAULT      1024
+/// Generator version, part of the texture parameters. Bump it whenever a
+/// pattern changes, so that cached textures are not reused
+#define GENERATOR_VERSION           3
+/// Image format of streamed textures, the only one written incrementally
+#define STREAM_FORMAT               "ppm"
+
+/// Inter-stage queue capacity, per worker thread
+#define QUEUE_SLOTS_PER_WORKER      2
+
+std::string getScript(
+    const std::string & material_name,
+    const std::string & image_name){
+
+    std::stringstream script_str;
+    script_str
+    << "material " << MATERIAL_PREFIX << material_name
+    << std::endl << "{"
+    << std::endl << "  technique"
+    << std::endl << "  {"
+    << std::endl << "    pass"
+    << std::endl << "    {"
+    << std::endl << "      texture_unit"
+    << std::endl << "      {"
+    << std::endl << "        texture " << TEXTURE_PREFIX << image_name
+    << std::endl << "        filtering anistropic"
+    << std::endl << "        max_anisotropy 16"
+    << std::endl << "      }"
+    << std::endl << "    }"
+    << std::endl << "  }"
+    << std::endl << "}" << std::endl;
+    return script_str.str();
+}
 
 void genScript(
     const std::string material_name,
     const std::string image_name,
     const std::string & scripts_dir){
 
-    std::stringstream script_str;
     std::stringstream file_path;
 
     if (GENERATE_SCRIPT){
 
-        script_str
-        << "material " << MATERIAL_PREFIX << material_name
-        << std::endl << "{"
-        << std::endl << "  technique"
-        << std::endl << "  {"
-        << std::endl << "    pass"
-        << std::endl << "    {"
-        << std::endl << "      texture_unit"
-        << std::endl << "      {"
-        << std::endl << "        texture " << TEXTURE_PREFIX << image_name
-        << std::endl << "        filtering anistropic"
-        << std::endl << "        max_anisotropy 16"
-        << std::endl << "      }"
-        << std::endl << "    }"
-        << std::endl << "  }"
-        << std::endl << "}" << std::endl;
-
         file_path << scripts_dir << material_name << MATERIAL_EXT;
 
         /* Write to file */
         std::ofstream ofs(file_path.str());
-        ofs << script_str.str();
+        ofs << getScript(material_name, image_name);
         ofs.close();
     }
 }
 
 void genNames(const char* prefix,
     const int index,
+    const char* extension,
     const std::string & textures_dir,
     std::string & material,
     std::string & image,
@@ -119,7 +166,7 @@ void genNames(const char* prefix,
     s_img.str(std::string());
     s_file.str(std::string());
     s_mat << prefix << std::setw(6) << std::setfill('0') << std::to_string(index);
-    s_img << prefix << std::to_string(index) << IMG_EXT;
+    s_img << prefix << std::to_string(index) << extension;
     s_file << textures_dir << s_img.str();
 
     material = s_mat.str();
@@ -135,133 +182,788 @@ const std::string getUsage(const char* argv_0)
         "options: -n <number of textures generate>\n"  +
         "         -i <index of the first texure>\n" +
         "         -d <output directory>\n" +
-        "         -t <texture type>\n" +
-        "         -r <image resolution>\n";
+        "         -t <texture type: flat, chess, gradient, perlin, fractal, or all but fractal>\n" +
+        "         -r <image resolution>\n" +
+        "         -j <worker threads per pipeline stage>\n" +
+        "         -S <random seed>\n" +
+        "         -p <perlin noise precision: double, float or fixed>\n" +
+        "         -s stream textures in bands to ." + STREAM_FORMAT + " files, for textures larger than memory\n" +
+        "         -f <image format: dds with mipmaps, jpg, png, ppm, raw or webp>\n" +
+        "         -q <jpg or webp quality 0-100, png compression level 0-9>\n" +
+        "         -e <encoding and writing threads per stage, defaults to -j>\n" +
+        "         -a pack the images into textures/" + ARCHIVE_NAME + " and the materials into scripts/" + ARCHIVE_MATERIALS + "\n" +
+        "         -c <cache directory of encoded textures, reused across runs>\n" +
+        "         -m <cache size limit in MB>\n" +
+        "         -I <seconds between stage reports, 0 for one at the end>\n" +
+        "         -J <stage report JSON file>\n" +
+        "         -k, --shard <k/N> generate every index i with i % N == k, recording the\n" +
+        "             completed ones in a manifest so that a rerun resumes, requires -S\n" +
+        "         -V, --verify on resume, checksum the completed images instead of checking\n" +
+        "             their size and modification time\n";
 }
 
+/// An image file format the textures can be written in
+struct ImageFormat
+{
+    /// Name selected with -f
+    const char * name;
+    /// File extension, also selects the OpenCV encoder
+    const char * extension;
+    /// OpenCV encoder parameter set by -q, or -1 when there is none
+    int quality_param;
+    /// Range of -q
+    int min_quality, max_quality;
+    /// Pixels written as they are in memory, without encoding
+    bool raw;
+    /// Written with the mip chain, drawn from the texture definition
+    bool mipmaps;
+};
+
+/// Formats selectable with -f. WebP is only available when OpenCV was
+/// built with it, which is checked at startup
+const ImageFormat IMAGE_FORMATS[] = {
+    {"dds",  ".dds",  -1,                          0, 0,   false, true},
+    {"jpg",  ".jpg",  cv::IMWRITE_JPEG_QUALITY,    0, 100, false, false},
+    {"png",  ".png",  cv::IMWRITE_PNG_COMPRESSION, 0, 9,   false, false},
+    {"ppm",  ".ppm",  -1,                          0, 0,   false, false},
+    {"raw",  ".raw",  -1,                          0, 0,   true,  false},
+    {"webp", ".webp", cv::IMWRITE_WEBP_QUALITY,    1, 100, false, false}
+};
+
+/// Busy time of a pipeline stage, summed over its threads. Recorded into
+/// the instrumentation stage of the same name, whether enabled or not
+class StageTimer
+{
+    private:
+        /// Per texture latencies and busy time
+        Instrumentation::Stage & stage;
+
+    public:
+        explicit StageTimer(const char * name) :
+            stage(Instrumentation::stage(name)) {}
+
+        /// Runs function and adds its duration to the busy time
+        template <typename Function>
+        void time(Function function, uint64_t count = 0)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            function();
+            stage.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - begin).count(), count);
+        }
+
+        /// Gets the busy time in seconds
+        double seconds() const
+        {
+            return stage.getSeconds();
+        }
+};
+
+/// Where a generator draws its texture: into a reused pixel buffer, or
+/// streamed to a file band by band
+struct TextureCanvas
+{
+    /// Generated pixels, kept between textures
+    std::vector<uchar> * pixels;
+    /// File streamed textures are written to, NULL to draw into pixels
+    PpmWriter * writer;
+    /// Generated image, a header over pixels, empty when streaming
+    cv::Mat image;
+    /// Definition of the generated texture
+    TextureSpec spec;
+
+    /**
+     * @brief      Gets the target of a texture of the given size.
+     *
+     * @param      width   The width
+     * @param      height  The height
+     *
+     * @return     The render target.
+     */
+    RenderTarget target(const int & width, const int & height)
+    {
+        if (writer)
+            return RenderTarget(cv::Size(width, height), *writer);
+        // Reused between textures, only grows when a texture is larger
+        // than any before it
+        pixels->resize((size_t) width * height * 3);
+        image = cv::Mat(height, width, CV_8UC3, pixels->data());
+        return RenderTarget(image);
+    }
+
+    /**
+     * @brief      Draws a texture at its size, keeping its definition.
+     *
+     * @param      pattern_generation  The generator
+     * @param      spec                The texture
+     */
+    void draw(const PatternGeneration & pattern_generation, const TextureSpec & spec)
+    {
+        this->spec = spec;
+        pattern_generation.getProceduralTexture(spec).render(
+            target(spec.size.width, spec.size.height));
+    }
+
+    /**
+     * @brief      Shows the generated image, when it was drawn in memory.
+     *
+     * @param      title  The window title
+     */
+    void show(const char * title) const
+    {
+        if (SHOW_IMGS && !image.empty())
+            cv::imshow(title, image);
+    }
+};
+
 //////////////////////////////////////////////////
 void generateFlatTexture(PatternGeneration & pattern_generation,
-    unsigned int & resolution,
-    const unsigned int & i,
-    std::string & textures_dir,
-    std::string & scripts_dir)
-{    
-    std::string material_name, img_name, img_filename;
-    genNames("flat_", i, textures_dir, material_name, img_name, img_filename);
-    genScript(material_name, img_name, scripts_dir);
-    if (!GENERATE_IMG) return;
- 
-    cv::Scalar flat_color = pattern_generation.getRandomColor();
-    cv::Mat flat_texture = pattern_generation.getFlatTexture(flat_color,resolution);
-
-    if (!cv::imwrite(img_filename, flat_texture)){
-        std::cout << "[ERROR] Could not save " << img_filename <<
-        ". Please ensure the destination folder exists!" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    const unsigned int & resolution,
+    RandomEngine & rng,
+    TextureCanvas & canvas)
+{
+    TextureSpec spec(TextureSpec::FLAT, cv::Size(resolution, resolution));
+    spec.color1 = pattern_generation.getRandomColor(rng);
+    canvas.draw(pattern_generation, spec);
 
-    if (SHOW_IMGS)
-        cv::imshow("Flat texture", flat_texture);
+    canvas.show("Flat texture");
 };
 
 //////////////////////////////////////////////////
 void generateChessTexture(PatternGeneration & pattern_generation,
-    unsigned int & resolution,
-    const unsigned int & i,
-    std::string & textures_dir,
-    std::string & scripts_dir)
+    const unsigned int & resolution,
+    RandomEngine & rng,
+    TextureCanvas & canvas)
 {
-    std::string material_name, img_name, img_filename;
-    genNames("chess_", i, textures_dir, material_name, img_name, img_filename);
-    genScript(material_name, img_name, scripts_dir);
-    if (!GENERATE_IMG) return;
-
-    /* Initialize random device */
-    std::random_device rd;
-    std::mt19937 mt(rd());
-    std::uniform_int_distribution<int> dist;
     int squares;
     int block_size;
     /* Generate square texture */
-    squares = dist(mt) % 20 + 8;     // v2 in the range 1 to 100
+    squares = rng.uniform(20) + 8;   // in the range 8 to 27
     block_size = resolution / squares;
     if (block_size % 2 == 0)
         block_size++;
 
-    cv::Scalar chess_color_1    = pattern_generation.getRandomColor();
-    cv::Scalar chess_color_2    = pattern_generation.getRandomColor();
-
-    cv::Mat chess_board = pattern_generation.getChessTexture(chess_color_1, chess_color_2, block_size, squares);
+    TextureSpec spec(TextureSpec::CHESS, cv::Size(block_size * squares, block_size * squares));
+    spec.color1 = pattern_generation.getRandomColor(rng);
+    spec.color2 = pattern_generation.getRandomColor(rng);
+    spec.block_size = block_size;
+    canvas.draw(pattern_generation, spec);
 
     // Convert to HSV
     //cv::applyColorMap(chess_board, chess_board, cv::COLORMAP_LAB);
 
-    if (!cv::imwrite(img_filename, chess_board)){
-        std::cout << "[ERROR] Could not save " << img_filename <<
-        ". Please ensure the destination folder exists!" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    canvas.show("Chess board");
+};
 
-    if (SHOW_IMGS)
-        cv::imshow("Chess board", chess_board);
+//////////////////////////////////////////////////
+void generateGradientTexture(PatternGeneration & pattern_generation,
+    const unsigned int & resolution,
+    RandomEngine & rng,
+    TextureCanvas & canvas)
+{
+    TextureSpec spec(TextureSpec::GRADIENT, cv::Size(resolution, resolution));
+    spec.color1 = pattern_generation.getRandomColor(rng);
+    spec.color2 = pattern_generation.getRandomColor(rng);
+    spec.vertical = false;
+    canvas.draw(pattern_generation, spec);
 
+    canvas.show("Gradient texture");
 };
 
 //////////////////////////////////////////////////
-void generateGradientTexture(PatternGeneration & pattern_generation,
-    unsigned int & resolution,
-    const unsigned int & i,
-    std::string & textures_dir,
-    std::string & scripts_dir)
+void generatePerlinTexture(PatternGeneration & pattern_generation,
+    const unsigned int & resolution,
+    RandomEngine & rng,
+    TextureCanvas & canvas)
 {
-    std::string material_name, img_name, img_filename;
-    genNames("gradient_", i, textures_dir, material_name, img_name, img_filename);
-    genScript(material_name, img_name, scripts_dir);
-    if (!GENERATE_IMG) return;
+    /* Generate perlin noise texture */
+    TextureSpec spec(TextureSpec::PERLIN, cv::Size(resolution, resolution));
+    spec.z1 = rng.uniformReal();
+    spec.z2 = rng.uniformReal();
+    spec.z3 = rng.uniformReal();
+    spec.random_colors = rng.uniform(2);
+    // The permutation vector and pixel stream are drawn from what follows
+    spec.rng = rng;
+    canvas.draw(pattern_generation, spec);
 
-    cv::Scalar gradient_color_1 = pattern_generation.getRandomColor();
-    cv::Scalar gradient_color_2 = pattern_generation.getRandomColor();
-    cv::Mat gradient_texture = pattern_generation.getGradientTexture(gradient_color_1, gradient_color_2, resolution, false);
+    canvas.show("Perlin noise texture");
+};
 
-    if (!cv::imwrite(img_filename, gradient_texture)){
-    std::cout << "[ERROR] Could not save " << img_filename <<
-        ". Please ensure the destination folder exists!" << std::endl;
-        exit(EXIT_FAILURE);
+//////////////////////////////////////////////////
+void generateFractalTexture(PatternGeneration & pattern_generation,
+    const unsigned int & resolution,
+    RandomEngine & rng,
+    TextureCanvas & canvas)
+{
+    /* Generate fractal noise texture */
+    TextureSpec spec(TextureSpec::FRACTAL, cv::Size(resolution, resolution));
+    spec.type = (FractalNoise::Type) rng.uniform(3);
+    spec.octaves = rng.uniform(8) + 1;          // in the range 1 to 8
+    spec.gain = 0.35 + 0.3 * rng.uniformReal();
+    spec.frequency = rng.uniform(7) + 2;        // in the range 2 to 8
+    // The permutation vector and planes are drawn from what follows
+    spec.rng = rng;
+    canvas.draw(pattern_generation, spec);
+
+    canvas.show("Fractal noise texture");
+};
+
+/// Texture generator signature, the texture is drawn into the canvas
+typedef void (*TextureGenerator)(PatternGeneration &, const unsigned int &, RandomEngine &,
+    TextureCanvas &);
+
+/// A pattern the driver can generate
+struct PatternType
+{
+    /// Name prefix, e.g. "flat_"
+    const char * prefix;
+    /// Generator for this pattern
+    TextureGenerator generator;
+    /// Random stream id, fixed per pattern so that the texture with a given
+    /// index is the same whichever subset of patterns is generated
+    unsigned int stream;
+    /// Whether -t all generates it. Patterns added later are only generated
+    /// when selected, so that existing datasets keep their contents
+    bool in_all;
+};
+
+/// Patterns selectable with -t, in generation order
+const PatternType PATTERN_TYPES[] = {
+    {"flat_",     &generateFlatTexture,     0, true},
+    {"chess_",    &generateChessTexture,    1, true},
+    {"gradient_", &generateGradientTexture, 2, true},
+    {"perlin_",   &generatePerlinTexture,   3, true},
+    {"fractal_",  &generateFractalTexture,  4, false}
+};
+
+//////////////////////////////////////////////////
+uint64_t checksum(const void * data, const std::size_t & size, uint64_t hash = 14695981039346656037ULL)
+{
+    // FNV-1a 64, continued from hash
+    const uchar * bytes = static_cast<const uchar *>(data);
+    for (std::size_t k = 0; k < size; ++k) {
+        hash ^= bytes[k];
+        hash *= 1099511628211ULL;
     }
+    return hash;
+}
+
+//////////////////////////////////////////////////
+uint64_t fileChecksum(const std::string & path)
+{
+    // Streamed images may not fit in memory, read back in chunks
+    std::ifstream ifs(path, std::ios::binary);
+    std::vector<char> chunk(1 << 20);
+    uint64_t hash = checksum(NULL, 0);
+    while (ifs.read(chunk.data(), chunk.size()) || ifs.gcount() > 0)
+        hash = checksum(chunk.data(), ifs.gcount(), hash);
+    return hash;
+}
+
+//////////////////////////////////////////////////
+uint64_t modificationTime(const std::string & path)
+{
+    // Nanoseconds, 0 when the file is missing
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return 0;
+    return (uint64_t) status.st_mtim.tv_sec * 1000000000ULL + status.st_mtim.tv_nsec;
+}
 
-    if (SHOW_IMGS)
-        cv::imshow("Gradient texture", gradient_texture);
+/// A texture a shard completed
+struct ManifestEntry
+{
+    /// Image size in bytes
+    std::size_t size;
+    /// Image checksum, FNV-1a 64
+    uint64_t checksum;
+    /// Image modification time in nanoseconds, 0 when not recorded
+    uint64_t mtime;
 };
 
+/// Textures completed by one shard, one line each, appended and flushed as
+/// they are written, so that a run that stopped half way can be resumed.
+/// The first line holds the generation parameters common to every texture,
+/// a manifest is only resumed with the same ones
+class Manifest
+{
+    private:
+        /// Manifest file, appended to
+        std::ofstream file;
+        /// Serializes the writes
+        std::mutex mutex;
+        /// Completed textures read when opening, by image name
+        std::unordered_map<std::string, ManifestEntry> completed;
+
+    public:
+        /**
+         * @brief      Opens a manifest, reading the textures it lists as
+         *             completed, or starts a new one.
+         *
+         * @param      path    The file
+         * @param      params  The generation parameters common to every texture
+         *
+         * @return     False when the manifest has other parameters or could
+         *             not be written.
+         */
+        bool open(const std::string & path, const std::string & params)
+        {
+            const std::string header = "# " + params;
+            std::ifstream ifs(path);
+            std::string line;
+            bool exists = (bool) std::getline(ifs, line);
+            if (exists && line != header)
+                return false;
+            // A line cut short by a crash has no checksum and is ignored.
+            // Lines of older manifests have no modification time
+            while (std::getline(ifs, line)) {
+                std::istringstream fields(line);
+                std::string name;
+                ManifestEntry entry;
+                if (!(fields >> name >> entry.size >> std::hex >> entry.checksum))
+                    continue;
+                if (!(fields >> std::dec >> entry.mtime))
+                    entry.mtime = 0;
+                completed[name] = entry;
+            }
+            ifs.close();
+
+            file.open(path, std::ios::app);
+            if (!exists)
+                file << header << std::endl;
+            return (bool) file;
+        }
+
+        /**
+         * @brief      Checks whether a texture was completed, and its image is
+         *             still there with the recorded size. An image also left
+         *             with the recorded modification time is taken as is,
+         *             other ones are read back and compared to the recorded
+         *             checksum, so that one overwritten since is drawn again.
+         *
+         * @param      name    The image name
+         * @param      path    The image file
+         * @param      verify  Whether to read back every image, to catch
+         *                     corruption that kept the modification time
+         */
+        bool isCompleted(const std::string & name, const std::string & path,
+            const bool & verify) const
+        {
+            auto it = completed.find(name);
+            if (it == completed.end())
+                return false;
+            boost::system::error_code error;
+            if (boost::filesystem::file_size(path, error) != it->second.size)
+                return false;
+            if (!verify && it->second.mtime != 0 && modificationTime(path) == it->second.mtime)
+                return true;
+            return fileChecksum(path) == it->second.checksum;
+        }
+
+        /**
+         * @brief      Records a completed texture.
+         *
+         * @param      name      The image name
+         * @param      size      The image size in bytes
+         * @param      checksum  The image checksum
+         * @param      mtime     The image modification time in nanoseconds
+         * @param      params    The texture parameters
+         *
+         * @return     False when the line could not be written.
+         */
+        bool add(const std::string & name, const std::size_t & size, const uint64_t & checksum,
+            const uint64_t & mtime, const std::string & params)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            file << name << " " << size << " " << std::hex << std::setw(16) << std::setfill('0')
+                << checksum << std::dec << std::setfill(' ') << " " << mtime << " " << params
+                << std::endl;
+            return (bool) file;
+        }
+};
+
+/// A single texture travelling through the batch pipeline
+struct TextureJob
+{
+    /// Pattern of this texture
+    const PatternType * pattern;
+    /// Texture index
+    unsigned int index;
+    /// Generated image, a header over pixels, empty when streamed
+    cv::Mat image;
+    /// Definition of the generated texture, for its mip chain
+    TextureSpec spec;
+    /// Mip chain, the first level over image, kept when the job is recycled
+    std::vector<cv::Mat> levels;
+    /// Generated pixels, kept when the job is recycled
+    std::vector<uchar> pixels;
+    /// Encoded image file contents, kept when the job is recycled
+    std::vector<uchar> encoded;
+    /// Whether encoded was found in the cache, skipping generation
+    bool cached;
+    /// Whether a stage failed, the texture is then neither written nor
+    /// recorded in the manifest
+    bool failed;
+    /// When the generator picked the job up
+    std::chrono::steady_clock::time_point started;
+};
+
+/// Textures packed into one archive, with one material script for all
+struct ArchiveOutput
+{
+    /// Archive of the images
+    TextureArchiveWriter archive;
+    /// Material scripts, appended one after the other
+    std::ofstream materials;
+    /// Materials already in the scripts, each defined once
+    std::unordered_set<std::string> scripted;
+    /// Serializes the material script writes
+    std::mutex mutex;
+
+    // The archive is appended to, a later run adds the textures missing from
+    // it. The scripts are rebuilt from the images it already holds, since
+    // OGRE rejects a material defined twice and a crash may have left the
+    // scripts behind the archive
+    ArchiveOutput(const std::string & archive_file, const std::string & materials_file,
+        const std::vector<std::string> & archived) :
+        archive(archive_file), materials(materials_file, std::ios::trunc)
+    {
+        for (const std::string & img_name : archived) {
+            // Image names are the pattern prefix, the index and the extension
+            const std::string stem = boost::filesystem::path(img_name).stem().string();
+            const std::size_t separator = stem.rfind('_');
+            if (separator == std::string::npos)
+                continue;
+            std::string material_name, image, image_file;
+            genNames(stem.substr(0, separator + 1).c_str(), atoi(stem.c_str() + separator + 1),
+                "", "", material_name, image, image_file);
+            addScript(material_name, img_name);
+        }
+    }
+
+    /**
+     * @brief      Appends the material script of a texture, unless its
+     *             material is already defined.
+     *
+     * @param      material_name  The material name
+     * @param      img_name       The image name
+     */
+    void addScript(const std::string & material_name, const std::string & img_name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (scripted.insert(material_name).second)
+            materials << getScript(material_name, img_name);
+    }
+};
+
+/// Output settings of the batch pipeline
+struct PipelineOutput
+{
+    /// Image format
+    const ImageFormat * format;
+    /// Encoder parameters, empty for the format defaults
+    std::vector<int> params;
+    /// Stream textures to files from the generators, without encoding
+    bool streaming;
+    /// Output directories
+    std::string textures_dir, scripts_dir;
+    /// Archive the textures are packed into, NULL for one file per texture
+    ArchiveOutput * archive;
+    /// Cache of encoded textures, NULL for none
+    TextureCache * cache;
+    /// Generation parameters common to every texture
+    std::string texture_params;
+    /// Seconds between stage reports, 0 for one at the end, negative for none
+    double report_interval;
+    /// Manifest of the completed textures, NULL for none
+    Manifest * manifest;
+};
+
+//////////////////////////////////////////////////
+std::string textureParams(const TextureJob & job, const PipelineOutput & output)
+{
+    // Everything the encoded texture depends on, hence the cache key
+    std::stringstream params;
+    params << output.texture_params << " pattern=" << job.pattern->prefix <<
+    " index=" << job.index;
+    return params.str();
+}
+
 //////////////////////////////////////////////////
-void generatePerlinTexture(PatternGeneration & pattern_generation, unsigned int & resolution, const unsigned int & i, std::string & textures_dir, std::string & scripts_dir)
+bool recordTexture(const TextureJob & job,
+    const PipelineOutput & output,
+    const std::string & img_name,
+    const std::string & img_filename,
+    const std::size_t & size,
+    const uint64_t & hash)
 {
+    if (output.manifest && !output.manifest->add(img_name, size, hash,
+        modificationTime(img_filename), textureParams(job, output))){
+        std::cout << "[ERROR] Could not record " << img_name << " in the manifest" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////
+bool writeTexture(TextureJob & job,
+    const PipelineOutput & output,
+    std::size_t & size)
+{
+    size = 0;
     std::string material_name, img_name, img_filename;
-    genNames("perlin_", i, textures_dir, material_name, img_name, img_filename);
-    genScript(material_name, img_name, scripts_dir);
-    if (!GENERATE_IMG) return;
+    genNames(job.pattern->prefix, job.index, output.format->extension,
+        output.textures_dir, material_name, img_name, img_filename);
+    {
+        INSTRUMENT_SCOPE("script", 1);
+        if (!output.archive)
+            genScript(material_name, img_name, output.scripts_dir);
+        else if (GENERATE_SCRIPT && !GENERATE_IMG)
+            output.archive->addScript(material_name, img_name);
+    }
+    if (!GENERATE_IMG)
+        return recordTexture(job, output, img_name, img_filename, 0, checksum(NULL, 0));
+    // Streamed images were written by the generator
+    if (output.streaming)
+        return !output.manifest || recordTexture(job, output, img_name, img_filename,
+            boost::filesystem::file_size(img_filename), fileChecksum(img_filename));
 
-    static std::random_device rd;
-    static std::mt19937 mt(rd());
-    static std::uniform_int_distribution<int> dist;
-    /* Generate perlin noise texture */
-    double z1 = ((double) dist(mt) / (RAND_MAX));
-    double z2 = ((double) dist(mt) / (RAND_MAX));
-    double z3 = ((double) dist(mt) / (RAND_MAX));
-    srand(time(0));
-    int randomval = dist(mt) % 2;
+    // Raw images are written straight from the pixels, which are continuous,
+    // unless they were read from the cache
+    const bool pixels = output.format->raw && !job.cached;
+    const uchar * data = pixels ? job.image.data : job.encoded.data();
+    const std::size_t data_size = pixels ? job.image.total() * job.image.elemSize() :
+        job.encoded.size();
 
-    cv::Mat perlin_texture = pattern_generation.getPerlinNoiseTexture(resolution,randomval,z1,z2,z3);
+    if (output.archive) {
+        if (!output.archive->archive.add(img_name, textureParams(job, output), data, data_size)){
+            std::cout << "[ERROR] Could not add " << img_name << " to the archive" << std::endl;
+            return false;
+        }
+        // Only once the image is archived, a resumed run skips it
+        if (GENERATE_SCRIPT) {
+            INSTRUMENT_SCOPE("script", 1);
+            output.archive->addScript(material_name, img_name);
+        }
+        size = data_size;
+        return true;
+    }
+
+    std::ofstream ofs(img_filename, std::ios::binary);
+    ofs.write(reinterpret_cast<const char *>(data), data_size);
+    ofs.close();
 
-    if (!cv::imwrite(img_filename, perlin_texture)){
-    std::cout << "[ERROR] Could not save " << img_filename <<
+    if (!ofs){
+        std::cout << "[ERROR] Could not save " << img_filename <<
         ". Please ensure the destination folder exists!" << std::endl;
-        exit(EXIT_FAILURE);
+        return false;
     }
+    size = data_size;
+    // Only once the image is complete on disk
+    return !output.manifest ||
+        recordTexture(job, output, img_name, img_filename, data_size, checksum(data, data_size));
+}
 
-    if (SHOW_IMGS)
-        cv::imshow("Perlin noise texture", perlin_texture);
-};
+//////////////////////////////////////////////////
+unsigned int runPipeline(PatternGeneration & pattern_generation,
+    std::vector<TextureJob> & jobs,
+    const unsigned int & resolution,
+    const unsigned int & workers,
+    const unsigned int & io_workers,
+    const PipelineOutput & output)
+{
+    // Each stage owns its own pool; the queues in between hold at most
+    // QUEUE_SLOTS_PER_WORKER images per worker, so a fast generator waits
+    // for the encoder instead of piling up decoded images in memory
+    BoundedQueue<TextureJob> encode_queue(io_workers * QUEUE_SLOTS_PER_WORKER);
+    BoundedQueue<TextureJob> write_queue(io_workers * QUEUE_SLOTS_PER_WORKER);
+
+    // Written jobs go back to a free pool with their pixel and encoding
+    // buffers, enough for every job that can be in flight at once. Once
+    // the buffers have grown to the texture size, no stage allocates
+    const std::size_t in_flight = workers + io_workers * (2 + 2 * QUEUE_SLOTS_PER_WORKER);
+    BoundedQueue<TextureJob> free_jobs(in_flight);
+    for (std::size_t k = 0; k < in_flight; ++k)
+        free_jobs.push(TextureJob());
+
+    std::atomic<std::size_t> next_job {0};
+    std::atomic<unsigned int> written {0};
+    std::atomic<unsigned int> failed {0};
+    std::atomic<std::size_t> written_bytes {0};
+    std::mutex progress_mutex;
+    StageTimer generate_timer("generate"), encode_timer("encode"), write_timer("write");
+    Instrumentation::Stage & texture_stage = Instrumentation::stage("texture");
+    auto begin = std::chrono::steady_clock::now();
+    auto last_report = begin;
+
+    // Split the cores among the generation workers, so that the OpenMP
+    // regions inside the generators do not oversubscribe the machine
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    int omp_threads = std::max(1u, cores / workers);
+
+    std::vector<std::thread> generators, encoders, writers;
+
+    for (unsigned int w = 0; w < workers; ++w) {
+        generators.emplace_back([&]{
+#ifdef _OPENMP
+            omp_set_num_threads(omp_threads);
+#endif
+            std::size_t j;
+            TextureJob job;
+            while ((j = next_job++) < jobs.size() && free_jobs.pop(job)) {
+                job.pattern = jobs[j].pattern;
+                job.index = jobs[j].index;
+                job.started = std::chrono::steady_clock::now();
+                job.cached = false;
+                job.failed = false;
+                if (GENERATE_IMG && output.cache) {
+                    INSTRUMENT_SCOPE("cache_get", 1);
+                    job.cached = output.cache->get(textureParams(job, output), job.encoded);
+                }
+                if (job.cached) {
+                    encode_queue.push(std::move(job));
+                    continue;
+                }
+                RandomEngine rng = pattern_generation.getRandomEngine(
+                    job.index, job.pattern->stream);
+                if (GENERATE_IMG && output.streaming) {
+                    // Written band by band, only one band of tiles is held
+                    // in memory whatever the resolution
+                    std::string material_name, img_name, img_filename;
+                    genNames(job.pattern->prefix, job.index, output.format->extension,
+                        output.textures_dir, material_name, img_name, img_filename);
+                    PpmWriter writer(img_filename);
+                    TextureCanvas canvas = {&job.pixels, &writer, cv::Mat(), TextureSpec()};
+                    generate_timer.time([&]{
+                        job.pattern->generator(pattern_generation, resolution, rng, canvas);
+                    }, (uint64_t) resolution * resolution);
+                    if (!writer.good()){
+                        std::cout << "[ERROR] Could not save " << img_filename <<
+                        ". Please ensure the destination folder exists!" << std::endl;
+                        job.failed = true;
+                    } else
+                        written_bytes += boost::filesystem::file_size(img_filename);
+                } else if (GENERATE_IMG) {
+                    TextureCanvas canvas = {&job.pixels, NULL, cv::Mat(), TextureSpec()};
+                    generate_timer.time([&]{
+                        job.pattern->generator(pattern_generation, resolution, rng, canvas);
+                    }, (uint64_t) resolution * resolution);
+                    job.image = canvas.image;
+                    job.spec = canvas.spec;
+                }
+                encode_queue.push(std::move(job));
+            }
+        });
+    }
+
+    // Encoding and writing have their own threads, so that slow formats
+    // or disks can be given more of them than the generators
+    for (unsigned int w = 0; w < io_workers; ++w) {
+        encoders.emplace_back([&]{
+            TextureJob job;
+            while (encode_queue.pop(job)) {
+                if (GENERATE_IMG && !output.streaming && !output.format->raw && !job.cached &&
+                    !job.failed) {
+                    bool encoded = false;
+                    encode_timer.time([&]{
+                        if (!output.format->mipmaps) {
+                            encoded = cv::imencode(output.format->extension, job.image,
+                                job.encoded, output.params);
+                            return;
+                        }
+                        // The levels below the generated image are drawn
+                        // from its definition, not downsampled
+                        const ProceduralTexture texture =
+                            pattern_generation.getProceduralTexture(job.spec);
+                        job.levels.resize(texture.getMipLevels());
+                        job.levels[0] = job.image;
+                        texture.renderMipmaps(job.levels, 1);
+                        encoded = encodeDds(job.levels, job.encoded);
+                        job.levels[0].release();
+                    }, job.image.total());
+                    if (!encoded) {
+                        std::cout << "[ERROR] Could not encode " << job.pattern->prefix <<
+                        job.index << output.format->extension << std::endl;
+                        job.failed = true;
+                    }
+                }
+                if (GENERATE_IMG && output.cache && !job.cached && !job.failed) {
+                    INSTRUMENT_SCOPE("cache_put", 1);
+                    const std::string params = textureParams(job, output);
+                    bool stored = output.format->raw ?
+                        output.cache->put(params, job.image.data,
+                            job.image.total() * job.image.elemSize()) :
+                        output.cache->put(params, job.encoded.data(), job.encoded.size());
+                    if (!stored)
+                        std::cout << "[WARNING] Could not cache " << params << std::endl;
+                }
+                write_queue.push(std::move(job));
+            }
+        });
+
+        writers.emplace_back([&]{
+            TextureJob job;
+            while (write_queue.pop(job)) {
+                // A failed texture is left out of the manifest and the
+                // archive, so that a resumed run draws it again
+                std::size_t size = 0;
+                if (job.failed)
+                    ++failed;
+                else
+                    write_timer.time([&]{
+                        if (!writeTexture(job, output, size))
+                            ++failed;
+                    }, 1);
+                written_bytes += size;
+                // From the generator picking the job up to the texture written,
+                // waits in the queues included
+                auto now = std::chrono::steady_clock::now();
+                texture_stage.add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - job.started).count(), 1);
+                job.image.release();
+                free_jobs.push(std::move(job));
+                unsigned int done = ++written;
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                std::cout << "\rGenerating " << done << " of " << jobs.size() << std::flush;
+                if (output.report_interval > 0 && std::chrono::duration<double>(
+                    now - last_report).count() >= output.report_interval) {
+                    last_report = now;
+                    std::cout << std::endl;
+                    Instrumentation::report(std::cout);
+                }
+            }
+        });
+    }
+
+    for (std::thread & t : generators) t.join();
+    encode_queue.close();
+    for (std::thread & t : encoders) t.join();
+    write_queue.close();
+    for (std::thread & t : writers) t.join();
+    std::cout << std::endl;
+
+    // Busy time is summed over the threads of a stage, the stage with the
+    // most busy time per thread bounds the throughput
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - begin;
+    const double n = std::max<std::size_t>(1, jobs.size());
+    std::cout << std::fixed << std::setprecision(3)
+        << "Stage      threads  busy [s]  per texture [ms]" << std::endl
+        << "generate " << std::setw(9) << workers << std::setw(10) << generate_timer.seconds()
+        << std::setw(18) << generate_timer.seconds() / n * 1e3 << std::endl
+        << "encode   " << std::setw(9) << io_workers << std::setw(10) << encode_timer.seconds()
+        << std::setw(18) << encode_timer.seconds() / n * 1e3 << std::endl
+        << "write    " << std::setw(9) << io_workers << std::setw(10) << write_timer.seconds()
+        << std::setw(18) << write_timer.seconds() / n * 1e3 << std::endl
+        << "Wrote " << written_bytes / 1e6 << " MB in " << wall.count() << " s, "
+        << jobs.size() / wall.count() << " textures/s" << std::endl;
+    if (output.cache)
+        std::cout << "Cache: " << output.cache->getHits() << " hits, "
+            << output.cache->getMisses() << " misses, " << output.cache->getEvictions()
+            << " evictions, " << output.cache->getSize() / 1e6 << " MB" << std::endl;
+    if (output.report_interval >= 0)
+        Instrumentation::report(std::cout);
+    return failed;
+}
 
 //////////////////////////////////////////////////
 void parseArgs(
@@ -271,12 +973,43 @@ void parseArgs(
     unsigned int & start,
     std::string & output,
     unsigned int & resolution,
-    std::string & type)
+    std::string & type,
+    unsigned int & workers,
+    bool & seeded,
+    uint64_t & seed,
+    std::string & precision,
+    bool & streaming,
+    std::string & format,
+    int & quality,
+    unsigned int & io_workers,
+    bool & archive,
+    std::string & cache_dir,
+    unsigned int & cache_size,
+    double & report_interval,
+    std::string & report_file,
+    unsigned int & shard,
+    unsigned int & shards,
+    bool & verify)
 {
     int opt;
-    bool d, t, i, s, r;
+    bool d = false, t = false, i = false, s = false, r = false, j = false, e = false, m = false;
+    seeded = false;
+    streaming = false;
+    archive = false;
+    quality = -1;
+    report_interval = -1;
+    shard = 0;
+    shards = 0;
+    verify = false;
 
-    while ( (opt = getopt(argc,argv,"d: t: n: s: i: r:")) != EOF)
+    const struct option long_options[] = {
+        {"shard", required_argument, NULL, 'k'},
+        {"verify", no_argument, NULL, 'V'},
+        {NULL, 0, NULL, 0}
+    };
+
+    while ( (opt = getopt_long(argc,argv,"d: t: n: s i: r: j: S: p: f: q: e: a c: m: I: J: k: V",
+        long_options, NULL)) != EOF)
     {
         switch (opt)
         {
@@ -290,6 +1023,38 @@ void parseArgs(
                 i=true; start = atoi(optarg); break;
             case 'r':
                 r=true; resolution = atoi(optarg); break;
+            case 'j':
+                j=true; workers = atoi(optarg); break;
+            case 'S':
+                seeded=true; seed = strtoull(optarg, NULL, 10); break;
+            case 'p':
+                precision = optarg; break;
+            case 's':
+                streaming = true; break;
+            case 'f':
+                format = optarg; break;
+            case 'q':
+                quality = atoi(optarg); break;
+            case 'e':
+                e=true; io_workers = atoi(optarg); break;
+            case 'a':
+                archive = true; break;
+            case 'c':
+                cache_dir = optarg; break;
+            case 'm':
+                m=true; cache_size = atoi(optarg); break;
+            case 'I':
+                report_interval = std::max(0.0, atof(optarg)); break;
+            case 'J':
+                report_file = optarg; break;
+            case 'k':
+                if (sscanf(optarg, "%u/%u", &shard, &shards) != 2 || shard >= shards){
+                    std::cout << "Invalid shard " << optarg << ", expected k/N with k < N" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'V':
+                verify = true; break;
             default:
                 std::cout << getUsage(argv[0]) << std::endl;
                 exit(EXIT_FAILURE);
@@ -302,6 +1067,10 @@ void parseArgs(
     if (!r) resolution  = ARG_IMG_RESOLUTION_DEFAULT;
     if (!i) start       = ARG_START_DEFAULT;
     if (!t) type        = ARG_TYPE_DEFAULT;
+    if (!j || workers == 0) workers = ARG_JOBS_DEFAULT;
+    if (!e || io_workers == 0) io_workers = workers;
+    if (!m) cache_size = ARG_CACHE_SIZE_DEFAULT;
+    if (format.empty()) format = streaming ? STREAM_FORMAT : ARG_FORMAT_DEFAULT;
 }
 
 //////////////////////////////////////////////////
@@ -311,12 +1080,30 @@ int main(int argc, char **argv)
     unsigned int textures {0};
     unsigned int start {0};
     unsigned int resolution {0};
+    unsigned int workers {0};
+    unsigned int io_workers {0};
+    bool seeded {false};
+    bool streaming {false};
+    bool archive {false};
+    std::string cache_dir;
+    unsigned int cache_size {0};
+    double report_interval {-1};
+    std::string report_file;
+    unsigned int shard {0};
+    unsigned int shards {0};
+    bool verify {false};
+    int quality {-1};
+    std::string format;
+    uint64_t seed {0};
+    std::string precision {ARG_PRECISION_DEFAULT};
     std::string type;
     std::string media_dir;
     std::string output_dir;
 
     /* root directory */
-    parseArgs(argc, argv, textures, start, media_dir, resolution, type);
+    parseArgs(argc, argv, textures, start, media_dir, resolution, type, workers, seeded, seed, precision,
+        streaming, format, quality, io_workers, archive, cache_dir, cache_size, report_interval,
+        report_file, shard, shards, verify);
     std::string textures_dir=media_dir+"textures/";
     std::string scripts_dir=media_dir+"scripts/";
 
@@ -330,54 +1117,233 @@ int main(int argc, char **argv)
         std::cout << "Created " << scripts_dir << " folder"<< "\n";
     }
 
-    /* Initialize random device */
-    std::random_device rd;
-    std::mt19937 mt(rd());
-    std::uniform_int_distribution<int> dist;
-
     /* Pattern generator object instance */
     PatternGeneration pattern_generation;
+    if (seeded)
+        pattern_generation.setSeed(seed);
+    std::cout << "Using seed " << pattern_generation.getSeed() << std::endl;
 
-    for (unsigned int i = start; i < textures; ++i)
+    if (precision == "double")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_DOUBLE);
+    else if (precision == "float")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_FLOAT);
+    else if (precision == "fixed")
+        pattern_generation.setPrecision(PatternGeneration::PRECISION_FIXED);
+    else
     {
-        std::cout << "\rGenerating " << i + 1 << " of " << textures << std::flush;
+        std::cerr << "Unknown precision " << precision << "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-        if (type=="all")
-        {
-            /* Generate flat texture */
-            generateFlatTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
-            /* Generate chess texture */
-            generateChessTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
-            /* Generate gradient texture */
-            generateGradientTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
-            /* Generate perlin noise texture */
-            generatePerlinTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
-        }
-        else if (type=="perlin")
+    /* Texture types to generate for each index */
+    std::vector<const PatternType *> patterns;
+    for (const PatternType & pattern : PATTERN_TYPES)
+    {
+        std::string name(pattern.prefix, strlen(pattern.prefix) - 1);
+        if ((type=="all" && pattern.in_all) || type==name)
+            patterns.push_back(&pattern);
+    }
+
+    if (patterns.empty())
+    {
+        std::cerr << "No valid option selected! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    /* Image format and encoder parameters */
+    PipelineOutput output;
+    output.format = NULL;
+    output.streaming = streaming;
+    output.textures_dir = textures_dir;
+    output.scripts_dir = scripts_dir;
+    output.archive = NULL;
+    output.cache = NULL;
+    output.report_interval = report_interval;
+    output.manifest = NULL;
+    for (const ImageFormat & image_format : IMAGE_FORMATS)
+    {
+        if (format == image_format.name)
+            output.format = &image_format;
+    }
+
+    if (!output.format)
+    {
+        std::cerr << "Unknown image format " << format << "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (streaming && format != STREAM_FORMAT)
+    {
+        std::cerr << "Streamed textures can only be written as " << STREAM_FORMAT <<
+        "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (quality >= 0)
+    {
+        if (output.format->quality_param < 0 || quality < output.format->min_quality ||
+            quality > output.format->max_quality)
         {
-            /* Generate perlin noise texture */
-            generatePerlinTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
+            std::cerr << "Invalid quality " << quality << " for " << format <<
+            "! Exiting..." << std::endl;
+            exit(EXIT_FAILURE);
         }
-        else if (type=="gradient")
+        output.params = {output.format->quality_param, quality};
+    }
+    if (streaming && archive)
+    {
+        std::cerr << "Streamed textures cannot be archived! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (streaming && !cache_dir.empty())
+    {
+        std::cerr << "Streamed textures cannot be cached! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // Every shard must draw the same textures, and cannot share an archive
+    // with the other shards
+    if (shards && !seeded)
+    {
+        std::cerr << "Sharded runs need a seed, set with -S! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (shards && archive)
+    {
+        std::cerr << "Sharded runs cannot be archived! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Not every OpenCV build has every encoder, e.g. WebP. DDS files are
+    // written by the library
+    std::vector<uchar> probe;
+    if (!output.format->raw && !output.format->mipmaps && !streaming &&
+        !cv::imencode(output.format->extension, cv::Mat(1, 1, CV_8UC3, cv::Scalar()), probe))
+    {
+        std::cerr << "This OpenCV build cannot encode " << format << "! Exiting..." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::stringstream params;
+    params << "version=" << GENERATOR_VERSION << " seed=" << pattern_generation.getSeed() <<
+    " resolution=" << resolution << " precision=" << precision << " format=" << format;
+    if (quality >= 0)
+        params << " quality=" << quality;
+    output.texture_params = params.str();
+
+    // A shard resumes from its manifest, skipping the textures it lists
+    Manifest manifest;
+    if (shards)
+    {
+        char manifest_name[64];
+        snprintf(manifest_name, sizeof(manifest_name), MANIFEST_FORMAT, shard, shards);
+        if (!manifest.open(media_dir + manifest_name, output.texture_params))
         {
-            /* Generate gradient texture */
-            generateGradientTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
+            std::cerr << "Could not open " << media_dir << manifest_name <<
+            ", or it was written with other parameters! Exiting..." << std::endl;
+            exit(EXIT_FAILURE);
         }
-        else if (type=="flat")
+        output.manifest = &manifest;
+    }
+
+    // An archive resumes from its own records, skipping the textures it
+    // holds with the same parameters
+    std::unordered_map<std::string, std::string> archived;
+    std::vector<std::string> archived_names;
+    if (archive)
+    {
+        TextureArchiveReader previous;
+        if (previous.open(textures_dir + ARCHIVE_NAME))
+            for (const TextureArchive::Entry & entry : previous.getEntries())
+            {
+                archived[entry.name] = entry.params;
+                archived_names.push_back(entry.name);
+            }
+    }
+
+    // Indices are dealt round robin to the shards, so that every shard gets
+    // a similar mix of cheap and expensive textures
+    std::vector<TextureJob> jobs;
+    std::size_t resumed = 0;
+    for (unsigned int i = start; i < textures; ++i)
+    {
+        if (shards && i % shards != shard)
+            continue;
+        for (const auto & pattern : patterns)
         {
-            /* Generate flat texture */
-            generateFlatTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
+            TextureJob job;
+            job.pattern = pattern;
+            job.index = i;
+            if (shards || !archived.empty())
+            {
+                std::string material_name, img_name, img_filename;
+                genNames(pattern->prefix, i, output.format->extension, textures_dir,
+                    material_name, img_name, img_filename);
+                auto it = archived.find(img_name);
+                if ((shards && manifest.isCompleted(img_name, img_filename, verify)) ||
+                    (it != archived.end() && it->second == textureParams(job, output)))
+                {
+                    ++resumed;
+                    continue;
+                }
+            }
+            jobs.push_back(job);
         }
-        else if (type=="chess")
+    }
+    if (shards)
+        std::cout << "Shard " << shard << " of " << shards << ": " << resumed <<
+        " textures already done, " << jobs.size() << " to go" << std::endl;
+    else if (!archived.empty())
+        std::cout << resumed << " textures already archived, " << jobs.size() << " to go" <<
+        std::endl;
+
+    // One archive and one material script instead of two files per texture
+    std::unique_ptr<ArchiveOutput> archive_output;
+    if (archive)
+    {
+        archive_output.reset(new ArchiveOutput(textures_dir + ARCHIVE_NAME,
+            scripts_dir + ARCHIVE_MATERIALS, archived_names));
+        output.archive = archive_output.get();
+    }
+
+    std::unique_ptr<TextureCache> cache;
+    if (!cache_dir.empty())
+    {
+        cache.reset(new TextureCache(cache_dir, (uint64_t) cache_size << 20));
+        output.cache = cache.get();
+    }
+
+    // Library stages, e.g. the color conversion, are only timed on request.
+    // The pipeline stages always are
+    Instrumentation::setEnabled(report_interval >= 0 || !report_file.empty());
+    // Failed textures are reported as they happen, the others are still
+    // written, and a later run with the same options retries them
+    const unsigned int failed =
+        runPipeline(pattern_generation, jobs, resolution, workers, io_workers, output);
+
+    if (!report_file.empty())
+    {
+        std::ofstream ofs(report_file);
+        Instrumentation::reportJson(ofs);
+        if (!ofs)
         {
-            /* Generate chess texture */
-            generateChessTexture(pattern_generation, resolution, i, textures_dir, scripts_dir);
+            std::cerr << "Could not write " << report_file << "! Exiting..." << std::endl;
+            exit(EXIT_FAILURE);
         }
-        else
+    }
+
+    if (archive_output)
+    {
+        archive_output->materials.close();
+        if (!archive_output->archive.close() || !archive_output->materials)
         {
-            std::cerr << "No valid option selected! Exiting..." << std::endl;
+            std::cout << "[ERROR] Could not save " << textures_dir << ARCHIVE_NAME <<
+            ". Please ensure the destination folder exists!" << std::endl;
             exit(EXIT_FAILURE);
         }
     }
+    if (failed)
+    {
+        std::cout << "[ERROR] " << failed << " of " << jobs.size() <<
+        " textures could not be written" << std::endl;
+        return EXIT_FAILURE;
+    }
     return 0;
 }